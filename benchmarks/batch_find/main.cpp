@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <files/basic_allocator.h>
+#include <files/unordered_map.h>
+
+/*  Use the basic allocator so only probing is timed, not
+    page faults of a file on disk.
+*/
+using Map   = MmapFiles::unordered_map_file<
+    std::size_t,
+    std::size_t,
+    std::hash<std::size_t>,
+    MmapFiles::basic_allocator>;
+using Size  = typename Map::size_type;
+using Clock = std::chrono::steady_clock;
+
+constexpr Size  default_buckets = 16777213;
+constexpr Size  lookups         = 4000000;
+constexpr float load            = 0.75;
+
+double
+elapsed_ns(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char const *argv[])
+{
+    const Size buckets = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : default_buckets;
+
+    std::mt19937_64 gen(buckets);
+
+    Map map;
+    map.bucket_choices({buckets});
+    map.rehash(buckets);
+
+    /*  Keys are random so the table is hit all over, half
+        of the lookups miss.
+    */
+    std::vector<Size> inserted;
+    const Size elems = buckets * static_cast<double>(load);
+    while (map.size() != elems)
+    {
+        const auto k = gen() >> 1;
+        if (map.emplace(k, k).second)
+        {
+            inserted.push_back(k);
+        }
+    }
+
+    std::vector<Size> keys(lookups);
+    for (auto& k : keys)
+    {
+        k = gen() % 2 ? inserted[gen() % inserted.size()] : gen() >> 1;
+    }
+
+    std::unique_ptr<bool[]> out(new bool[lookups]);
+
+    auto start = Clock::now();
+    for (Size i = 0; i != lookups; ++i)
+    {
+        out[i] = map.contains(keys[i]);
+    }
+    const auto loop_ns = elapsed_ns(start, Clock::now()) / lookups;
+
+    Size found = 0;
+    for (Size i = 0; i != lookups; ++i)
+    {
+        found += out[i];
+    }
+
+    start = Clock::now();
+    map.contains_batch(keys.data(), lookups, out.get());
+    const auto batch_ns = elapsed_ns(start, Clock::now()) / lookups;
+
+    for (Size i = 0; i != lookups; ++i)
+    {
+        found -= out[i];
+    }
+
+    if (found != 0)
+    {
+        std::cerr << "benchmark is broken, batch and loop disagree\n";
+        return 1;
+    }
+
+    std::cout << "buckets " << buckets << " load " << load << "\n";
+    std::cout << "loop ns\tbatch ns\n";
+    std::cout << loop_ns << "\t" << batch_ns << "\n";
+
+    return 0;
+}
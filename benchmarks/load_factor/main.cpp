@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <files/basic_allocator.h>
+#include <files/unordered_map.h>
+
+/*  Use the basic allocator so only probing is timed, not
+    page faults of a file on disk.
+*/
+using Map   = MmapFiles::unordered_map_file<
+    std::size_t,
+    std::size_t,
+    std::hash<std::size_t>,
+    MmapFiles::basic_allocator>;
+using Size  = typename Map::size_type;
+using Clock = std::chrono::steady_clock;
+
+constexpr Size  default_buckets = 1048573;
+constexpr float loads[]         = { 0.5, 0.75, 0.9, 1.0 };
+
+/**
+ * @brief Time looking up every key.
+ *
+ * @return double nanoseconds per lookup
+ */
+double
+time_lookups(const Map& map, const std::vector<Size>& keys, Size& found)
+{
+    const auto start = Clock::now();
+    for (auto k : keys)
+    {
+        found += map.find(k) != map.cend();
+    }
+    const auto end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / keys.size();
+}
+
+int main(int argc, char const *argv[])
+{
+    const Size buckets = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : default_buckets;
+
+    std::mt19937_64 gen(buckets);
+
+    std::cout << "buckets " << buckets << "\n";
+    std::cout << "load\thit ns\tmiss ns\n";
+
+    for (auto load : loads)
+    {
+        Map map;
+        map.bucket_choices({buckets});
+        map.rehash(buckets);
+
+        const Size elems = buckets * static_cast<double>(load);
+
+        std::vector<Size> hits, misses;
+        hits.reserve(elems);
+        misses.reserve(elems);
+
+        while (map.size() != elems)
+        {
+            const auto k = gen();
+            if (map.emplace(k, k).second)
+            {
+                hits.push_back(k);
+            }
+        }
+
+        while (misses.size() != elems)
+        {
+            const auto k = gen();
+            if (!map.contains(k))
+            {
+                misses.push_back(k);
+            }
+        }
+
+        std::shuffle(hits.begin(), hits.end(), gen);
+
+        Size found = 0;
+        const auto hit_ns  = time_lookups(map, hits, found);
+        const auto miss_ns = time_lookups(map, misses, found);
+
+        if (found != elems || map.bucket_count() != buckets)
+        {
+            std::cerr << "benchmark is broken, found " << found << " of " << elems << "\n";
+            return 1;
+        }
+
+        std::cout << load << "\t" << hit_ns << "\t" << miss_ns << "\n";
+    }
+
+    return 0;
+}
@@ -3,7 +3,7 @@
 #include <sstream>
 #include <vector>
 
-#include <files/Allocators.h>
+#include <files/mmap_allocator.h>
 
 using Vec = std::vector<int, MmapFiles::mmap_allocator<int>>;
 
@@ -25,7 +25,11 @@ std::ostream& operator<<(std::ostream& out, const Vec& v)
 
 int main(int argc, char const *argv[])
 {
-    Vec v1 = { 4,8,1,5,7 }, v2 = { 8,7,5,4,1};
+    /*  Named so the data lands in files, a default constructed
+        allocator maps anonymous memory.
+    */
+    Vec v1({ 4,8,1,5,7 }, MmapFiles::mmap_allocator<int>("v1.dat"));
+    Vec v2({ 8,7,5,4,1 }, MmapFiles::mmap_allocator<int>("v2.dat"));
 
     std::cout << v1 << "\n" << v2 << "\n";
 
@@ -36,7 +40,7 @@ int main(int argc, char const *argv[])
     std::cout << "vector are same is " << std::boolalpha << (v1 == v2) << "\n";
     std::cout <<
         "use command: " <<
-        "od -t d" << sizeof(int) << " --width=" << sizeof(int) << " FILE_NAME\n";
+        "od -t d" << sizeof(int) << " --width=" << sizeof(int) << " v1.dat\n";
 
     return 0;
 }
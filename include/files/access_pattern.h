@@ -0,0 +1,28 @@
+#ifndef CUSTOM_FILE_LIBRARY_ACCESS_PATTERN
+#define CUSTOM_FILE_LIBRARY_ACCESS_PATTERN
+
+#include "defs.h"
+
+/*  How a container expects to touch its file, given to madvise so
+    the system reads ahead, or does not, to match.
+
+        normal      - the default readahead of the system
+        random      - point lookups, MADV_RANDOM, no readahead
+                      since the next bucket read is anywhere
+        sequential  - iteration and rehash, MADV_SEQUENTIAL,
+                      aggressive readahead, pages dropped early
+                      behind
+*/
+
+FILE_NAMESPACE_BEGIN
+
+enum class access_pattern
+{
+    normal,
+    random,
+    sequential
+};
+
+FILE_NAMESPACE_END
+
+#endif
@@ -2,10 +2,12 @@
 #define CUSTOM_FILE_LIBRARY_BASIC_ALLOCATOR
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <utility>
 
+#include "access_pattern.h"
 #include "defs.h"
 
 FILE_NAMESPACE_BEGIN
@@ -66,6 +68,72 @@ public:
         return ptr;
     }
 
+    /**
+     * @brief Make n T from addr read as zero bytes.
+     *
+     * @param addr inside memory returned from allocate
+     * @param n number of T to clear
+     */
+    void
+    clear(pointer addr, size_type n)
+    {
+        std::memset(static_cast<void*>(addr), 0, n * sizeof(T));
+    }
+
+    /**
+     * @brief For compatibility with mmap allocator. There is
+     *        nothing to write to.
+     *
+     * @return size_type 0, no bytes written
+     */
+    size_type
+    flush(pointer, size_type, bool)
+    {
+        return 0;
+    }
+
+    /**
+     * @brief For compatibility with mmap allocator. The memory is
+     *        not read from a file, there is nothing to advise.
+     *
+     * @return true
+     */
+    bool
+    advise(pointer, size_type, access_pattern)
+    {
+        return true;
+    }
+
+    /**
+     * @brief For compatibility with mmap allocator. Already in
+     *        memory.
+     */
+    void
+    warmup(pointer, size_type)
+    {
+    }
+
+    /**
+     * @brief For compatibility with mmap allocator. There is no
+     *        file to name.
+     */
+    void
+    use_sibling(const std::string&)
+    {
+    }
+
+    /**
+     * @brief For compatibility with mmap allocator. There is no
+     *        file to rename.
+     *
+     * @return true
+     */
+    bool
+    replace(const basic_allocator&)
+    {
+        return true;
+    }
+
     /**
      * @brief For compatibility with mmap allocator. Just
      *        disregard the naming request.
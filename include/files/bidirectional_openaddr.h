@@ -3,7 +3,9 @@
 
 #include <iterator>
 #include <cstddef>
+#include <cstdint>
 
+#include "bitmap.h"
 #include "defs.h"
 
 FILE_NAMESPACE_BEGIN
@@ -23,6 +25,16 @@ public:
     using value_type        = Underlying;
     using pointer           = Underlying*;
 
+    /**
+     * @brief Singular iterator, only assignable.
+     */
+    bidirectional_openaddr() :
+        M_data(nullptr), M_end(nullptr),
+        M_begin(nullptr), M_bits(nullptr),
+        M_lead(nullptr), M_lead_end(nullptr)
+    {
+    }
+
     /**
      * @brief
      *
@@ -31,13 +43,50 @@ public:
      * @param end one past end
      */
     bidirectional_openaddr(pointer curr, pointer end) :
-        M_data(curr), M_end(end)
+        M_data(curr), M_end(end),
+        M_begin(nullptr), M_bits(nullptr),
+        M_lead(nullptr), M_lead_end(nullptr)
+    {
+    }
+
+    /**
+     * @brief Iterator which finds taken elements from a bitmap
+     *        rather than reading every element, see bitmap.h.
+     *
+     * @param curr current pointer
+     * @param end one past end
+     * @param begin first element
+     * @param bits bit i is set if element i is taken
+     */
+    bidirectional_openaddr(pointer curr, pointer end,
+                           pointer begin, const std::uint64_t* bits) :
+        M_data(curr), M_end(end),
+        M_begin(begin), M_bits(bits),
+        M_lead(nullptr), M_lead_end(nullptr)
+    {
+    }
+
+    /**
+     * @brief Iterator which walks the elements in [lead,lead_end)
+     *        before the ones in [begin,end), for a container
+     *        moving its elements between two ranges. curr may be
+     *        in either.
+     *
+     * @param lead first element walked before begin
+     * @param lead_end one past the end of lead
+     */
+    bidirectional_openaddr(pointer curr, pointer end,
+                           pointer begin, const std::uint64_t* bits,
+                           pointer lead, pointer lead_end) :
+        M_data(curr), M_end(end),
+        M_begin(begin), M_bits(bits),
+        M_lead(lead), M_lead_end(lead_end)
     {
     }
 
     operator bidirectional_openaddr<const Val, Underlying, Cont, UtoV, IsFree>() const
     {
-        return bidirectional_openaddr<const Val, Underlying, Cont, UtoV, IsFree>(M_data, M_end);
+        return bidirectional_openaddr<const Val, Underlying, Cont, UtoV, IsFree>(M_data, M_end, M_begin, M_bits, M_lead, M_lead_end);
     }
 
     reference
@@ -55,10 +104,46 @@ public:
     bidirectional_openaddr<Val, Underlying, Cont, UtoV, IsFree>&
     operator++()
     {
+        if (in_lead())
+        {
+            do
+            {
+                ++M_data;
+            } while (M_data != M_lead_end && IsFree()(M_data));
+
+            if (M_data != M_lead_end)
+            {
+                return *this;
+            }
+
+            /*  Past the lead, on to the first taken element of
+                [begin,end).
+            */
+            if (M_bits)
+            {
+                M_data = M_begin + bitmap_next(M_bits, 0, M_end - M_begin);
+                return *this;
+            }
+
+            M_data = M_begin;
+            if (M_data == M_end || !IsFree()(M_data))
+            {
+                return *this;
+            }
+        }
+
+        if (M_bits)
+        {
+            const std::size_t size = M_end - M_begin;
+            M_data = M_begin + bitmap_next(M_bits, M_data - M_begin + 1, size);
+
+            return *this;
+        }
+
         do
         {
             ++M_data;
-        } while (IsFree()(M_data) && M_data != M_end);
+        } while (M_data != M_end && IsFree()(M_data));
 
         return *this;
     }
@@ -74,6 +159,47 @@ public:
     bidirectional_openaddr<Val, Underlying, Cont, UtoV, IsFree>&
     operator--()
     {
+        if (M_lead && !in_lead())
+        {
+            /*  In [begin,end), only back into the lead from its
+                first taken element.
+            */
+            const std::size_t size = M_end - M_begin;
+            const std::size_t at   = M_data - M_begin;
+            const auto prev = M_bits ? bitmap_prev(M_bits, at - 1, size) : size;
+            if (M_bits && prev != size)
+            {
+                M_data = M_begin + prev;
+                return *this;
+            }
+
+            for (auto p = M_data; !M_bits && p != M_begin;)
+            {
+                if (!IsFree()(--p))
+                {
+                    M_data = p;
+                    return *this;
+                }
+            }
+
+            M_data = M_lead_end;
+            do
+            {
+                --M_data;
+            } while (IsFree()(M_data));
+
+            return *this;
+        }
+
+        if (M_bits && !in_lead())
+        {
+            const std::size_t size = M_end - M_begin;
+            const auto prev = bitmap_prev(M_bits, M_data - M_begin - 1, size);
+            M_data = M_begin + (prev == size ? 0 : prev);
+
+            return *this;
+        }
+
         do
         {
             --M_data;
@@ -91,6 +217,17 @@ public:
     }
 
     pointer M_data, M_end;
+    pointer M_begin;
+    const std::uint64_t* M_bits;
+    pointer M_lead, M_lead_end;
+
+private:
+
+    bool
+    in_lead() const
+    {
+        return M_lead && M_data >= M_lead && M_data < M_lead_end;
+    }
 
 };
 
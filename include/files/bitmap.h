@@ -0,0 +1,107 @@
+#ifndef CUSTOM_FILE_LIBRARY_BITMAP
+#define CUSTOM_FILE_LIBRARY_BITMAP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "defs.h"
+
+/*  A bitmap is an array of 64 bit words, bit i is bit i % 64
+    of word i / 64. Bits past the size of a bitmap are always
+    zero.
+*/
+
+FILE_NAMESPACE_BEGIN
+
+constexpr std::size_t bitmap_word = 64;
+
+/**
+ * @brief Number of words needed for size bits.
+ */
+inline std::size_t
+bitmap_words(std::size_t size)
+{
+    return (size + bitmap_word - 1) / bitmap_word;
+}
+
+inline bool
+bitmap_test(const std::uint64_t* bits, std::size_t i)
+{
+    return (bits[i / bitmap_word] >> (i % bitmap_word)) & 1;
+}
+
+inline void
+bitmap_set(std::uint64_t* bits, std::size_t i)
+{
+    bits[i / bitmap_word] |= std::uint64_t(1) << (i % bitmap_word);
+}
+
+inline void
+bitmap_reset(std::uint64_t* bits, std::size_t i)
+{
+    bits[i / bitmap_word] &= ~(std::uint64_t(1) << (i % bitmap_word));
+}
+
+/**
+ * @brief First set bit at or after from, skipping a word of
+ *        clear bits at a time.
+ *
+ * @return std::size_t index of bit, size if there is none
+ */
+inline std::size_t
+bitmap_next(const std::uint64_t* bits, std::size_t from, std::size_t size)
+{
+    if (from >= size)
+    {
+        return size;
+    }
+
+    auto word = from / bitmap_word;
+    auto curr = bits[word] & (~std::uint64_t(0) << (from % bitmap_word));
+
+    const auto words = bitmap_words(size);
+    while (!curr)
+    {
+        if (++word == words)
+        {
+            return size;
+        }
+
+        curr = bits[word];
+    }
+
+    return word * bitmap_word + __builtin_ctzll(curr);
+}
+
+/**
+ * @brief Last set bit at or before from.
+ *
+ * @return std::size_t index of bit, size if there is none
+ */
+inline std::size_t
+bitmap_prev(const std::uint64_t* bits, std::size_t from, std::size_t size)
+{
+    if (from >= size)
+    {
+        return size;
+    }
+
+    auto word = from / bitmap_word;
+    auto curr = bits[word] & (~std::uint64_t(0) >> (bitmap_word - 1 - from % bitmap_word));
+
+    while (!curr)
+    {
+        if (word-- == 0)
+        {
+            return size;
+        }
+
+        curr = bits[word];
+    }
+
+    return word * bitmap_word + bitmap_word - 1 - __builtin_clzll(curr);
+}
+
+FILE_NAMESPACE_END
+
+#endif
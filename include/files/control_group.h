@@ -0,0 +1,164 @@
+#ifndef CUSTOM_FILE_LIBRARY_CONTROL_GROUP
+#define CUSTOM_FILE_LIBRARY_CONTROL_GROUP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
+#include "defs.h"
+
+/*  Control bytes are a byte per bucket kept beside the buckets
+    of a container. A byte is either
+
+        control_empty - bucket is free
+        0b0hhhhhhh    - bucket is taken, h are 7 bits of the hash
+                        of the element, see control_hash
+
+    A group is a number of consecutive control bytes which can
+    be compared against one byte at once. Which instructions are
+    used is picked at compile time, AVX2 then SSE2 then a scalar
+    fallback working on 8 bytes in a 64 bit word.
+*/
+
+FILE_NAMESPACE_BEGIN
+
+constexpr unsigned char control_empty = 0x80;
+
+/**
+ * @brief 7 bits of a hash to store in a control byte. Mixes in
+ *        the low bits so that small hashes (and reductions
+ *        using the high bits) still differ.
+ */
+inline unsigned char
+control_hash(std::size_t hash)
+{
+    return static_cast<unsigned char>((hash ^ (hash >> 57)) & 0x7f);
+}
+
+/**
+ * @brief Lowest set bit of a non zero mask.
+ */
+inline unsigned
+lowest_bit(std::uint32_t mask)
+{
+    return __builtin_ctz(mask);
+}
+
+#if defined(__AVX2__)
+
+struct control_group
+{
+    static constexpr std::size_t width = 32;
+
+    explicit control_group(const unsigned char* pos) :
+        M_ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos)))
+    {
+    }
+
+    /**
+     * @brief Bit i is set if byte i equals h.
+     */
+    std::uint32_t
+    match(unsigned char h) const
+    {
+        const auto cmp = _mm256_cmpeq_epi8(M_ctrl, _mm256_set1_epi8(static_cast<char>(h)));
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(cmp));
+    }
+
+    std::uint32_t
+    match_empty() const
+    {
+        return match(control_empty);
+    }
+
+    __m256i M_ctrl;
+};
+
+#elif defined(__SSE2__)
+
+struct control_group
+{
+    static constexpr std::size_t width = 16;
+
+    explicit control_group(const unsigned char* pos) :
+        M_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos)))
+    {
+    }
+
+    /**
+     * @brief Bit i is set if byte i equals h.
+     */
+    std::uint32_t
+    match(unsigned char h) const
+    {
+        const auto cmp = _mm_cmpeq_epi8(M_ctrl, _mm_set1_epi8(static_cast<char>(h)));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(cmp));
+    }
+
+    std::uint32_t
+    match_empty() const
+    {
+        return match(control_empty);
+    }
+
+    __m128i M_ctrl;
+};
+
+#else
+
+struct control_group
+{
+    static constexpr std::size_t width = 8;
+
+    explicit control_group(const unsigned char* pos)
+    {
+        std::memcpy(&M_ctrl, pos, sizeof(M_ctrl));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        M_ctrl = __builtin_bswap64(M_ctrl);
+#endif
+    }
+
+    /**
+     * @brief Bit i is set if byte i equals h.
+     */
+    std::uint32_t
+    match(unsigned char h) const
+    {
+        constexpr std::uint64_t lsb = 0x0101010101010101ull;
+        constexpr std::uint64_t low = 0x7f7f7f7f7f7f7f7full;
+
+        /*  Exact zero byte test, bytes of x are zero where
+            they equal h. Sets high bit of every zero byte.
+        */
+        const std::uint64_t x = M_ctrl ^ (lsb * h);
+        return compact(~(((x & low) + low) | x | low));
+    }
+
+    std::uint32_t
+    match_empty() const
+    {
+        return match(control_empty);
+    }
+
+    /**
+     * @brief Move the high bit of every byte into the low 8
+     *        bits, byte i to bit i.
+     */
+    static std::uint32_t
+    compact(std::uint64_t high_bits)
+    {
+        return static_cast<std::uint32_t>(((high_bits >> 7) * 0x0102040810204080ull) >> 56);
+    }
+
+    std::uint64_t M_ctrl;
+};
+
+#endif
+
+FILE_NAMESPACE_END
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef CUSTOM_FILE_LIBRARY_DURABILITY
+#define CUSTOM_FILE_LIBRARY_DURABILITY
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "defs.h"
+
+/*  When the changes to a container backed by a file reach the
+    disk.
+
+        none        - whenever the system writes them back, the
+                      container never syncs
+        periodic    - a thread syncs the whole file every period,
+                      the point a crash recovers to is at most a
+                      period old
+        on_close    - synced when the container is destroyed
+
+    flush and sync on the container sync explicitly in any mode.
+*/
+
+FILE_NAMESPACE_BEGIN
+
+/*  Largest number of bytes the periodic flusher syncs at once.
+*/
+constexpr std::size_t flush_chunk_bytes = std::size_t(64) << 20;
+
+enum class durability_mode
+{
+    none,
+    periodic,
+    on_close
+};
+
+/**
+ * @brief Count of syncs done and the bytes they covered. The
+ *        bytes are those asked to be synced, rounded out to
+ *        pages, not only the dirty ones.
+ */
+struct flush_stats
+{
+    std::uint64_t flushes;
+    std::uint64_t bytes;
+};
+
+/**
+ * @brief Calls a function every period on its own thread until
+ *        destroyed. The function is called with the lock held,
+ *        it may unlock it between steps.
+ */
+class periodic_flusher
+{
+public:
+
+    using lock_type = std::unique_lock<std::mutex>;
+    using function  = std::function<void(lock_type&)>;
+
+    periodic_flusher(std::chrono::milliseconds period, function flush) :
+        M_period(period),
+        M_flush(std::move(flush)),
+        M_stop(false),
+        M_thread(&periodic_flusher::run, this)
+    {
+    }
+
+    periodic_flusher(const periodic_flusher&) = delete;
+    periodic_flusher& operator=(const periodic_flusher&) = delete;
+
+    ~periodic_flusher()
+    {
+        {
+            std::lock_guard<std::mutex> guard(M_mutex);
+            M_stop = true;
+        }
+
+        M_cond.notify_one();
+        M_thread.join();
+    }
+
+    /**
+     * @brief Held while flushing, hold it to change what the
+     *        function looks at.
+     */
+    std::mutex&
+    mutex()
+    {
+        return M_mutex;
+    }
+
+    std::chrono::milliseconds
+    period() const
+    {
+        return M_period;
+    }
+
+private:
+
+    void
+    run()
+    {
+        lock_type lock(M_mutex);
+        while (!M_cond.wait_for(lock, M_period, [this]{ return M_stop; }))
+        {
+            M_flush(lock);
+        }
+    }
+
+    const std::chrono::milliseconds M_period;
+    const function                  M_flush;
+
+    std::mutex              M_mutex;
+    std::condition_variable M_cond;
+    bool                    M_stop;
+    std::thread             M_thread;
+
+};
+
+FILE_NAMESPACE_END
+
+#endif
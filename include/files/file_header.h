@@ -0,0 +1,95 @@
+#ifndef CUSTOM_FILE_LIBRARY_FILE_HEADER
+#define CUSTOM_FILE_LIBRARY_FILE_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <typeinfo>
+
+#include "defs.h"
+
+/*  A container backed by a file keeps a header at the start of
+    the file, before the buckets. It takes a whole number of
+    buckets, at least a page.
+
+    The header says how to read the rest of the file, so that a
+    file can be opened again without being told the number of
+    buckets and without looking at every bucket. A file written
+    by a container of different types is refused.
+*/
+
+FILE_NAMESPACE_BEGIN
+
+constexpr std::uint64_t file_header_magic   = 0x48534148504d4d46ull; // "FMMPHASH"
+constexpr std::uint32_t file_header_version = 2;
+constexpr std::size_t   file_header_bytes   = 4096;
+constexpr std::size_t   file_header_choices = 256;
+
+struct file_header
+{
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t clean;        // 1 if closed, elements is then right
+    std::uint64_t fingerprint;  // see type_fingerprint
+    std::uint64_t element_size;
+    std::uint64_t buckets;
+    std::uint64_t elements;
+    std::uint64_t max_probe;
+    std::uint64_t seed;         // hashes are not seeded, always 0
+    float         load;
+    std::uint32_t num_choices;
+    std::uint64_t choices[file_header_choices];
+};
+
+static_assert(sizeof(file_header) <= file_header_bytes, "header must fit in a page");
+static_assert(std::is_trivial<file_header>::value, "header is read from raw memory");
+
+/**
+ * @brief FNV-1a over the mangled names of Types. Differs when
+ *        any of the types differs, and unlike hash_code is the
+ *        same between runs.
+ */
+template<typename... Types>
+std::uint64_t
+type_fingerprint()
+{
+    const char* names[] = { typeid(Types).name()... };
+
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto name : names)
+    {
+        for (; *name; ++name)
+        {
+            hash ^= static_cast<unsigned char>(*name);
+            hash *= 0x100000001b3ull;
+        }
+
+        hash ^= 0xff;
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Check whether an allocator is backed by a file, that is
+ *        has member function file_size.
+ *
+ * @tparam Alloc allocator type to check
+ */
+template<typename Alloc, typename = void>
+struct is_file_backed :
+    std::false_type
+{
+};
+
+template<typename Alloc>
+struct is_file_backed<Alloc, typename std::conditional<true, void, decltype(&Alloc::file_size)>::type> :
+    std::true_type
+{
+};
+
+FILE_NAMESPACE_END
+
+#endif
@@ -0,0 +1,479 @@
+#ifndef CUSTOM_FILE_LIBRARY_GROWTH_POLICY
+#define CUSTOM_FILE_LIBRARY_GROWTH_POLICY
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "defs.h"
+
+/*  A growth policy decides the number of buckets a container
+    moves to once the bucket choices given to the container
+    run out. A policy is a stateless type with
+
+        next(n) - smallest number of buckets the policy allows
+                  which is greater than or equal to n
+        prev(n) - largest number of buckets the policy allows
+                  which is less than or equal to n, never less
+                  than 1
+        reduce  - type of the reduction used to take a hash to
+                  a bucket
+
+    when a policy cannot represent a size (ie would overflow)
+    next returns std::numeric_limits<std::size_t>::max().
+
+    A reduction is a stateless type with
+
+        mix(hash)       - applied once to the hash of a key, the
+                          result is what the container stores
+        (hash, buckets) - bucket in range [0,buckets) of a mixed
+                          hash
+        fits(buckets)   - true if the reduction works with that
+                          number of buckets
+*/
+
+FILE_NAMESPACE_BEGIN
+
+/**
+ * @brief Finalizer from murmur3. Spreads every bit of the input
+ *        over the output, so weak hashes such as the identity
+ *        std::hash<int> still fill all buckets.
+ */
+inline std::size_t
+mix_hash(std::size_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+/**
+ * @brief High 64 bits of the 128 bit product of a and b.
+ */
+inline std::uint64_t
+mul_high(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    return (static_cast<unsigned __int128>(a) * b) >> 64;
+#else
+    const std::uint64_t a_lo = a & 0xffffffffull, a_hi = a >> 32;
+    const std::uint64_t b_lo = b & 0xffffffffull, b_hi = b >> 32;
+
+    const std::uint64_t lo_lo = a_lo * b_lo;
+    const std::uint64_t hi_lo = a_hi * b_lo;
+    const std::uint64_t lo_hi = a_lo * b_hi;
+    const std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffull) + lo_hi;
+
+    return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/**
+ * @brief Division, works with any number of buckets. The
+ *        hash is used as is.
+ */
+struct modulo_reduce
+{
+    using size_type = std::size_t;
+
+    size_type
+    mix(size_type hash) const
+    {
+        return hash;
+    }
+
+    size_type
+    operator()(size_type hash, size_type buckets) const
+    {
+        return hash % buckets;
+    }
+
+    bool
+    fits(size_type buckets) const
+    {
+        return buckets != 0;
+    }
+};
+
+/**
+ * @brief Mask off the low bits, only works with a power of
+ *        two number of buckets.
+ *
+ * @tparam Mix true to apply @ref mix_hash to hashes. Without
+ *             it only the low bits of a hash are used
+ */
+template<bool Mix = true>
+struct mask_reduce
+{
+    using size_type = std::size_t;
+
+    size_type
+    mix(size_type hash) const
+    {
+        return Mix ? mix_hash(hash) : hash;
+    }
+
+    size_type
+    operator()(size_type hash, size_type buckets) const
+    {
+        return hash & (buckets - 1);
+    }
+
+    bool
+    fits(size_type buckets) const
+    {
+        return buckets != 0 && (buckets & (buckets - 1)) == 0;
+    }
+};
+
+/**
+ * @brief Lemire's fastrange, (hash * buckets) / 2^64. Works with
+ *        any number of buckets without a division. Uses the
+ *        high bits of a hash.
+ *
+ * @tparam Mix true to apply @ref mix_hash to hashes. Without
+ *             it small hashes all go to bucket 0
+ */
+template<bool Mix = true>
+struct fastrange_reduce
+{
+    using size_type = std::size_t;
+
+    static_assert(sizeof(size_type) == sizeof(std::uint64_t), "fastrange needs 64 bit size_t");
+
+    size_type
+    mix(size_type hash) const
+    {
+        return Mix ? mix_hash(hash) : hash;
+    }
+
+    size_type
+    operator()(size_type hash, size_type buckets) const
+    {
+        return mul_high(hash, buckets);
+    }
+
+    bool
+    fits(size_type buckets) const
+    {
+        return buckets != 0;
+    }
+};
+
+/**
+ * @brief Whether every hash keeps its place in the order of the
+ *        buckets when their number goes from from to to, so that
+ *        a rehash moves each element once in a single pass over
+ *        the buckets. That is when the bucket in to is the bucket
+ *        in from plus a multiple of from (splitting), or is never
+ *        after it (squeezing) with hashes in the same bucket in
+ *        from landing at most one bucket apart. Reductions not
+ *        listed below never do.
+ */
+template<typename Reduce>
+struct one_pass_rehash
+{
+    static bool
+    possible(std::size_t, std::size_t)
+    {
+        return false;
+    }
+};
+
+/**
+ * @brief Splits when growing to a multiple, h % (k * n) is
+ *        h % n plus a multiple of n.
+ */
+template<>
+struct one_pass_rehash<modulo_reduce>
+{
+    static bool
+    possible(std::size_t from, std::size_t to)
+    {
+        return from != 0 && to > from && to % from == 0;
+    }
+};
+
+/**
+ * @brief Splits when growing, every power of two is a multiple
+ *        of the smaller ones.
+ */
+template<bool Mix>
+struct one_pass_rehash<mask_reduce<Mix>>
+{
+    static bool
+    possible(std::size_t from, std::size_t to)
+    {
+        return from != 0 && to > from && to % from == 0;
+    }
+};
+
+/**
+ * @brief Squeezes when shrinking, the bucket is monotone in the
+ *        hash for any number of buckets.
+ */
+template<bool Mix>
+struct one_pass_rehash<fastrange_reduce<Mix>>
+{
+    static bool
+    possible(std::size_t from, std::size_t to)
+    {
+        return to != 0 && to < from;
+    }
+};
+
+/**
+ * @brief Largest primes below each power of two from 2^2 up
+ *        to 2^63, so the fewest buckets is 3. Each entry is
+ *        roughly double the one before, so growth through this
+ *        table is geometric.
+ *
+ * @tparam Reduce reduction, prime sizes are only useful with
+ *                @ref modulo_reduce
+ */
+template<typename Reduce = modulo_reduce>
+struct prime_growth_policy
+{
+    using size_type = std::size_t;
+    using reduce    = Reduce;
+
+    size_type
+    next(size_type n) const
+    {
+        for (size_type potential : primes())
+        {
+            if (potential >= n)
+            {
+                return potential;
+            }
+        }
+
+        return std::numeric_limits<size_type>::max();
+    }
+
+    size_type
+    prev(size_type n) const
+    {
+        size_type res = primes()[0];
+        for (size_type potential : primes())
+        {
+            if (potential > n)
+            {
+                break;
+            }
+
+            res = potential;
+        }
+
+        return res;
+    }
+
+private:
+
+    /*  Function local so the table can live in a header
+        without an out of class definition.
+    */
+    static const std::array<size_type, 62>&
+    primes()
+    {
+        static const std::array<size_type, 62> table =
+        {{
+            3ull,
+            7ull,
+            13ull,
+            31ull,
+            61ull,
+            127ull,
+            251ull,
+            509ull,
+            1021ull,
+            2039ull,
+            4093ull,
+            8191ull,
+            16381ull,
+            32749ull,
+            65521ull,
+            131071ull,
+            262139ull,
+            524287ull,
+            1048573ull,
+            2097143ull,
+            4194301ull,
+            8388593ull,
+            16777213ull,
+            33554393ull,
+            67108859ull,
+            134217689ull,
+            268435399ull,
+            536870909ull,
+            1073741789ull,
+            2147483647ull,
+            4294967291ull,
+            8589934583ull,
+            17179869143ull,
+            34359738337ull,
+            68719476731ull,
+            137438953447ull,
+            274877906899ull,
+            549755813881ull,
+            1099511627689ull,
+            2199023255531ull,
+            4398046511093ull,
+            8796093022151ull,
+            17592186044399ull,
+            35184372088777ull,
+            70368744177643ull,
+            140737488355213ull,
+            281474976710597ull,
+            562949953421231ull,
+            1125899906842597ull,
+            2251799813685119ull,
+            4503599627370449ull,
+            9007199254740881ull,
+            18014398509481951ull,
+            36028797018963913ull,
+            72057594037927931ull,
+            144115188075855859ull,
+            288230376151711717ull,
+            576460752303423433ull,
+            1152921504606846883ull,
+            2305843009213693951ull,
+            4611686018427387847ull,
+            9223372036854775783ull
+        }};
+
+        return table;
+    }
+
+};
+
+/**
+ * @brief Sizes form the sequence
+ *          s(0)   = 1
+ *          s(k+1) = max(s(k) + 1, s(k) * Num / Den)
+ *        By default that is a growth of 1.5x.
+ *
+ * @tparam Num numerator of growth factor
+ * @tparam Den denominator of growth factor, Num must be
+ *             greater than Den
+ * @tparam Reduce reduction, must work with any number of
+ *                buckets
+ */
+template<
+    std::size_t Num = 3, std::size_t Den = 2,
+    typename Reduce = modulo_reduce>
+struct geometric_growth_policy
+{
+    static_assert(Num > Den && Den > 0, "growth factor must be greater than 1");
+
+    using size_type = std::size_t;
+    using reduce    = Reduce;
+
+    size_type
+    next(size_type n) const
+    {
+        size_type curr = 1;
+        while (curr < n)
+        {
+            if (!grow(curr))
+            {
+                return std::numeric_limits<size_type>::max();
+            }
+        }
+
+        return curr;
+    }
+
+    size_type
+    prev(size_type n) const
+    {
+        size_type curr = 1, last = 1;
+        while (curr <= n)
+        {
+            last = curr;
+            if (!grow(curr))
+            {
+                break;
+            }
+        }
+
+        return last;
+    }
+
+private:
+
+    /**
+     * @brief Move s(k) to s(k+1).
+     *
+     * @return false if s(k+1) is not representable
+     */
+    static bool
+    grow(size_type& curr)
+    {
+        constexpr auto max_sz = std::numeric_limits<size_type>::max();
+        if (curr > max_sz / Num)
+        {
+            return false;
+        }
+
+        const size_type grown = curr * Num / Den;
+        curr = grown > curr ? grown : curr + 1;
+
+        return true;
+    }
+
+};
+
+/**
+ * @brief Sizes are powers of two. Bucket choices which are not
+ *        a power of two are skipped when using @ref mask_reduce.
+ *
+ * @tparam Reduce reduction, by default mask the low bits of a
+ *                mixed hash so that no division is done
+ */
+template<typename Reduce = mask_reduce<>>
+struct power_of_two_growth_policy
+{
+    using size_type = std::size_t;
+    using reduce    = Reduce;
+
+    size_type
+    next(size_type n) const
+    {
+        constexpr size_type top = (std::numeric_limits<size_type>::max() >> 1) + 1;
+        if (n > top)
+        {
+            return std::numeric_limits<size_type>::max();
+        }
+
+        size_type curr = 1;
+        while (curr < n)
+        {
+            curr <<= 1;
+        }
+
+        return curr;
+    }
+
+    size_type
+    prev(size_type n) const
+    {
+        size_type curr = 1;
+        while (curr <= n >> 1)
+        {
+            curr <<= 1;
+        }
+
+        return curr;
+    }
+
+};
+
+FILE_NAMESPACE_END
+
+#endif
@@ -1,16 +1,23 @@
 #ifndef CUSTOM_FILE_LIBRARY_MMAP_ALLOCATOR
 #define CUSTOM_FILE_LIBRARY_MMAP_ALLOCATOR
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <functional>
+#include <memory>
 #include <stdio.h>
+#include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <utility>
 
+#include "access_pattern.h"
 #include "defs.h"
 
 #ifndef _SC_PAGESIZE
@@ -21,11 +28,35 @@
     #endif
 #endif
 
+/*  Linux 5.14, older headers do not have it.
+*/
+#ifndef MADV_POPULATE_READ
+    #define MADV_POPULATE_READ 22
+#endif
+
 /*  NOTE: mmap vs mmap64 
 */
 
+/*  By default growing moves the mapping when it cannot be extended
+    where it is. With an address range reserved, see
+    mmap_allocator::reserve_address, the file is mapped at the
+    start of a PROT_NONE range and growth maps the new part of
+    the file after the old with MAP_FIXED. The start never moves
+    while the file fits in the range, and only the new pages are
+    mapped.
+*/
+
 FILE_NAMESPACE_BEGIN
 
+enum class huge_page_status
+{
+    off,         // not asked for
+    requested,   // asked for, nothing mapped since
+    advised,     // the last mapping was given MADV_HUGEPAGE
+    hugetlb,     // anonymous, from the pool of huge pages, MAP_HUGETLB
+    unavailable  // the system refused, normal pages are used
+};
+
 template<typename T>
 class mmap_allocator
 {
@@ -38,149 +69,617 @@ public:
 private:
 
     /**
-     * @brief A not very random but random enough name
-     *        generator.
+     * @brief The descriptor of the file, opened on first use and
+     *        kept until the last copy of the allocator is gone.
      *
-     * @return std::string string consisting of alpha characters
+     * @return int -1 with errno set if the file cannot be opened
      */
-    std::string
-    default_name_gen()
+    int
+    descriptor()
     {
-        static const char alphanum[] =
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz";
-
-        constexpr std::string::size_type len = 16;
-        std::string tmp_s;
-        tmp_s.reserve(len);
-        ::srand(::time(nullptr));
-        for (std::string::size_type i = 0; i != len; ++i)
-        {
-            tmp_s += alphanum[::rand() % (sizeof(alphanum) - 1)];
-        }
-
-        while (::access(tmp_s.c_str(), F_OK) == 0)
+        if (!M_fd)
         {
-            ::srand(::time(nullptr) * tmp_s[0]);
-            tmp_s.clear();
-
-            for (std::string::size_type i = 0; i != len; ++i)
+            const int fd = ::open(M_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRWXU | S_IROTH | S_IRGRP);
+            if (fd == -1)
             {
-                tmp_s += alphanum[::rand() % (sizeof(alphanum) - 1)];
+                return -1;
             }
+
+            M_fd.reset(new int(fd), [](int* p)
+            {
+                ::close(*p);
+                delete p;
+            });
         }
 
-        return tmp_s;
+        return *M_fd;
     }
 
-    int
-    open_or_create()
+    /**
+     * @brief Make the file sz bytes. Growing allocates the blocks
+     *        with fallocate, so that a full disk fails here rather
+     *        than with SIGBUS when a new page is first written. A
+     *        file system without fallocate grows sparse. A file
+     *        that cannot shrink keeps its size.
+     *
+     * @return false with errno set if the file could not grow
+     */
+    static bool
+    resize(int fd, size_type sz)
     {
-        int fd;
+        struct stat64 st;
+        if (::fstat64(fd, &st))
+        {
+            return false;
+        }
 
-        if (::access(M_file.c_str(), F_OK) == 0)
+        const auto old = static_cast<size_type>(st.st_size);
+        if (sz <= old)
         {
-            fd = ::open(M_file.c_str(), O_RDWR, 0);
+            if (sz < old)
+            {
+                ::ftruncate64(fd, sz);
+            }
+
+            return true;
         }
-        else
+
+        if (::fallocate64(fd, 0, old, sz - old) == 0)
         {
-            fd = ::open(M_file.c_str(), O_RDWR | O_CREAT, S_IRWXU | S_IROTH | S_IRGRP);
+            return true;
         }
 
-        return fd;
+        if (errno != EOPNOTSUPP && errno != ENOSYS)
+        {
+            /*  Some blocks may have been allocated, give them
+                back.
+            */
+            const int error = errno;
+            ::ftruncate64(fd, old);
+            errno = error;
+
+            return false;
+        }
+
+        return ::ftruncate64(fd, sz) == 0;
     }
 
-    int
-    close(int fd)
+    static size_type
+    page_size()
+    {
+        const auto page_sz = sysconf(_SC_PAGESIZE);
+
+        return page_sz == -1 ? 4096 : page_sz;
+    }
+
+    /**
+     * @brief Size of the pages mappings are made of, the huge page
+     *        size when huge pages are asked for.
+     */
+    size_type
+    granularity() const
     {
-        return ::close(fd);
+        return M_huge == huge_page_status::off ? page_size() : huge_page_size();
     }
 
+    /**
+     * @brief sz bytes rounded up to the pages actually mapped, sz
+     *        itself without huge pages.
+     */
     size_type
-    page_aligned(size_type n)
+    mapped_size(size_type sz) const
     {
-        auto page_sz = sysconf(_SC_PAGESIZE);
-        if (page_sz == -1)
+        if (M_huge == huge_page_status::off)
         {
-            page_sz = 4096;
+            return sz;
         }
 
+        const auto page = huge_page_size();
+        return (sz + page - 1) / page * page;
+    }
+
+    size_type
+    page_aligned(size_type n) const
+    {
+        const auto page = granularity();
+
         const auto sz = n * sizeof(value_type);
-        return sz + (page_sz - (sz % page_sz));
+        return (sz + page - 1) / page * page;
+    }
+
+    /**
+     * @brief Reserve sz bytes of address space starting on a huge
+     *        page boundary, to map over with MAP_FIXED.
+     */
+    void*
+    huge_aligned_range(size_type sz)
+    {
+        const auto page = huge_page_size();
+        const auto ptr  = ::mmap(nullptr, sz + page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            return MAP_FAILED;
+        }
+
+        const auto begin = reinterpret_cast<std::uintptr_t>(ptr);
+        const auto start = (begin + page - 1) / page * page;
+        if (start != begin)
+        {
+            ::munmap(ptr, start - begin);
+        }
+        ::munmap(reinterpret_cast<void*>(start + sz), begin + page - start);
+
+        return reinterpret_cast<void*>(start);
+    }
+
+    /**
+     * @brief Ask for sz bytes at ptr to be backed by huge pages,
+     *        recording whether the system took it.
+     */
+    void
+    advise_huge(void* ptr, size_type sz)
+    {
+        if (M_huge == huge_page_status::off || ptr == MAP_FAILED)
+        {
+            return;
+        }
+
+        M_huge = ::madvise(ptr, sz, MADV_HUGEPAGE) ? huge_page_status::unavailable
+                                                   : huge_page_status::advised;
     }
 
     pointer
     mmap(size_type sz)
     {
-        int fd = open_or_create();
-        if (fd == -1)
+        sz = mapped_size(sz);
+        if (anonymous())
         {
-            return reinterpret_cast<pointer>(MAP_FAILED);
+            return map_anonymous(sz);
         }
 
-        if (::ftruncate64(fd, sz))
+        const int fd = descriptor();
+        if (fd == -1 || !resize(fd, sz))
         {
-            close(fd);
             return reinterpret_cast<pointer>(MAP_FAILED);
         }
 
-        void* ptr = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-
-        if (close(fd))
+        void* ptr = MAP_FAILED;
+        if (M_reserve && sz <= M_reserve)
         {
-            ::munmap(ptr, sz);
-
-            return static_cast<pointer>(MAP_FAILED);
+            ptr = reserve();
+            if (ptr != MAP_FAILED)
+            {
+                ptr = ::mmap(ptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+            }
+        }
+        else if (M_huge != huge_page_status::off)
+        {
+            ptr = huge_aligned_range(sz);
+            if (ptr != MAP_FAILED)
+            {
+                ptr = ::mmap(ptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+            }
+        }
+        else
+        {
+            ptr = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
         }
 
+        advise_huge(ptr, sz);
+
         return static_cast<pointer>(ptr);
     }
 
     pointer
     mremap(pointer old_addr, size_type old_sz, size_type sz)
     {
-        int fd = open_or_create();
-        if (fd == -1)
+        old_sz = mapped_size(old_sz);
+        sz     = mapped_size(sz);
+        if (anonymous())
         {
-            return reinterpret_cast<pointer>(MAP_FAILED);
+            return remap_anonymous(old_addr, old_sz, sz);
         }
 
-        if (::ftruncate64(fd, sz))
+        const int fd = descriptor();
+        if (fd == -1 || !resize(fd, sz))
         {
-            close(fd);
             return reinterpret_cast<pointer>(MAP_FAILED);
         }
 
-        void* ptr = ::mremap(old_addr, old_sz, sz, MREMAP_MAYMOVE);
+        void* ptr = MAP_FAILED;
+        if (static_cast<void*>(old_addr) == M_base && sz <= M_reserve)
+        {
+            ptr = remap_fixed(fd, old_sz, sz);
+        }
+        else if (static_cast<void*>(old_addr) == M_base)
+        {
+            /*  Outgrew the range, map elsewhere and give the
+                range up.
+            */
+            ptr = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED)
+            {
+                ::munmap(M_base, M_reserve);
+                M_base    = nullptr;
+                M_reserve = 0;
+            }
+        }
+        else if (M_huge != huge_page_status::off)
+        {
+            /*  Grow in place, or move to a range that keeps the
+                huge page alignment.
+            */
+            ptr = ::mremap(old_addr, old_sz, sz, 0);
+            if (ptr == MAP_FAILED)
+            {
+                void* to = huge_aligned_range(sz);
+                if (to != MAP_FAILED)
+                {
+                    ptr = ::mremap(old_addr, old_sz, sz, MREMAP_MAYMOVE | MREMAP_FIXED, to);
+                    if (ptr == MAP_FAILED)
+                    {
+                        ::munmap(to, sz);
+                    }
+                }
+            }
+        }
+        else
+        {
+            ptr = ::mremap(old_addr, old_sz, sz, MREMAP_MAYMOVE);
+        }
+
+        advise_huge(ptr, sz);
+
+        return static_cast<pointer>(ptr);
+    }
+
+    pointer
+    map_anonymous(size_type sz)
+    {
+        constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
 
-        if (close(fd))
+        void* ptr = MAP_FAILED;
+        if (M_reserve && sz <= M_reserve)
         {
-            ::munmap(ptr, sz);
+            ptr = reserve();
+            if (ptr != MAP_FAILED)
+            {
+                ptr = ::mmap(ptr, sz, PROT_READ | PROT_WRITE, flags | MAP_FIXED, -1, 0);
+            }
+        }
+        else if (M_huge != huge_page_status::off)
+        {
+            ptr = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED)
+            {
+                M_huge = huge_page_status::hugetlb;
+                return static_cast<pointer>(ptr);
+            }
 
-            return static_cast<pointer>(MAP_FAILED);
+            ptr = huge_aligned_range(sz);
+            if (ptr != MAP_FAILED)
+            {
+                ptr = ::mmap(ptr, sz, PROT_READ | PROT_WRITE, flags | MAP_FIXED, -1, 0);
+            }
+        }
+        else
+        {
+            ptr = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, flags, -1, 0);
         }
 
+        advise_huge(ptr, sz);
+
         return static_cast<pointer>(ptr);
     }
 
+    pointer
+    remap_anonymous(pointer old_addr, size_type old_sz, size_type sz)
+    {
+        void* ptr = MAP_FAILED;
+        if (M_huge == huge_page_status::hugetlb)
+        {
+            /*  Huge pages from the pool are not moved by mremap on
+                every kernel, copy them instead.
+            */
+            M_huge = huge_page_status::requested;
+            ptr    = map_anonymous(sz);
+            if (ptr != MAP_FAILED)
+            {
+                std::memcpy(ptr, old_addr, std::min(old_sz, sz));
+                ::munmap(old_addr, old_sz);
+            }
+            else
+            {
+                M_huge = huge_page_status::hugetlb;
+            }
+
+            return static_cast<pointer>(ptr);
+        }
+
+        if (static_cast<void*>(old_addr) == M_base && sz <= M_reserve)
+        {
+            ptr = remap_fixed(-1, old_sz, sz);
+        }
+        else if (static_cast<void*>(old_addr) == M_base)
+        {
+            /*  Outgrew the range, the pages move out of it and the
+                rest of it is given up.
+            */
+            ptr = ::mremap(old_addr, old_sz, sz, MREMAP_MAYMOVE);
+            if (ptr != MAP_FAILED)
+            {
+                ::munmap(M_base, M_reserve);
+                M_base    = nullptr;
+                M_reserve = 0;
+            }
+        }
+        else if (M_huge != huge_page_status::off)
+        {
+            ptr = ::mremap(old_addr, old_sz, sz, 0);
+            if (ptr == MAP_FAILED)
+            {
+                void* to = huge_aligned_range(sz);
+                if (to != MAP_FAILED)
+                {
+                    ptr = ::mremap(old_addr, old_sz, sz, MREMAP_MAYMOVE | MREMAP_FIXED, to);
+                    if (ptr == MAP_FAILED)
+                    {
+                        ::munmap(to, sz);
+                    }
+                }
+            }
+        }
+        else
+        {
+            ptr = ::mremap(old_addr, old_sz, sz, MREMAP_MAYMOVE);
+        }
+
+        advise_huge(ptr, sz);
+
+        return static_cast<pointer>(ptr);
+    }
+
+    /**
+     * @brief Reserve M_reserve bytes of address space, nothing is
+     *        committed.
+     */
+    void*
+    reserve()
+    {
+        if (M_huge != huge_page_status::off)
+        {
+            M_reserve = mapped_size(M_reserve);
+            M_base    = huge_aligned_range(M_reserve);
+        }
+        else
+        {
+            M_base = ::mmap(nullptr, M_reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        }
+
+        if (M_base == MAP_FAILED)
+        {
+            M_base = nullptr;
+            return MAP_FAILED;
+        }
+
+        return M_base;
+    }
+
+    /**
+     * @brief Resize the mapping at M_base in place, growing maps
+     *        only the pages past the old size, shrinking gives
+     *        the pages past the new size back to the range.
+     */
+    void*
+    remap_fixed(int fd, size_type old_sz, size_type sz)
+    {
+        const auto page = page_size();
+        const auto base = static_cast<char*>(M_base);
+
+        if (sz > old_sz && fd == -1)
+        {
+            /*  Anonymous, the last page mapped already holds data
+                and is kept.
+            */
+            const auto from = (old_sz + page - 1) / page * page;
+            if (from >= sz)
+            {
+                return M_base;
+            }
+
+            void* ptr = ::mmap(base + from, sz - from, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+
+            return ptr == MAP_FAILED ? MAP_FAILED : M_base;
+        }
+
+        if (sz > old_sz)
+        {
+            const auto from = old_sz / page * page;
+            void* ptr = ::mmap(base + from, sz - from, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, from);
+
+            return ptr == MAP_FAILED ? MAP_FAILED : M_base;
+        }
+
+        const auto from = (sz + page - 1) / page * page;
+        const auto to   = (old_sz + page - 1) / page * page;
+        if (from < to)
+        {
+            ::mmap(base + from, to - from, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        }
+
+        return M_base;
+    }
+
+    /**
+     * @brief Unmap size bytes at addr, the whole range if
+     *        addr is its start.
+     */
+    void
+    unmap(pointer addr, size_type size)
+    {
+        if (static_cast<void*>(addr) == M_base)
+        {
+            ::munmap(M_base, M_reserve);
+            M_base = nullptr;
+            return;
+        }
+
+        ::munmap(addr, mapped_size(size));
+    }
+
 public:
 
     mmap_allocator() :
-        M_file(default_name_gen()),
-        M_least(false)
+        M_file(),
+        M_fd(),
+        M_least(false),
+        M_reserve(0),
+        M_base(nullptr),
+        M_huge(huge_page_status::off)
     {
     }
 
     mmap_allocator(std::string&& file) :
         M_file(std::move(file)),
-        M_least(false)
+        M_fd(),
+        M_least(false),
+        M_reserve(0),
+        M_base(nullptr),
+        M_huge(huge_page_status::off)
     {
     }
 
     mmap_allocator(const std::string& file) :
         M_file(file),
-        M_least(false)
+        M_fd(),
+        M_least(false),
+        M_reserve(0),
+        M_base(nullptr),
+        M_huge(huge_page_status::off)
+    {
+    }
+
+    /**
+     * @brief Whether there is no file, the memory is anonymous.
+     */
+    bool
+    anonymous() const
+    {
+        return M_file.empty();
+    }
+
+    /**
+     * @brief Map the file named with suffix added from now on, a
+     *        file of its own next to the one of this. Called on a
+     *        copy that has nothing allocated, the settings are
+     *        kept. Anonymous stays anonymous.
+     */
+    void
+    use_sibling(const std::string& suffix)
+    {
+        if (!anonymous())
+        {
+            M_file += suffix;
+        }
+
+        M_fd.reset();
+        M_least = false;
+        M_base  = nullptr;
+        if (M_huge != huge_page_status::off)
+        {
+            M_huge = huge_page_status::requested;
+        }
+    }
+
+    /**
+     * @brief Rename the file over the file of other, replacing it
+     *        in one step, and take its name. What is mapped stays
+     *        mapped, from either.
+     *
+     * @return false if renaming failed, nothing changed
+     */
+    bool
+    replace(const mmap_allocator& other)
     {
+        if (anonymous() || other.anonymous())
+        {
+            return true;
+        }
+
+        if (::rename(M_file.c_str(), other.M_file.c_str()))
+        {
+            return false;
+        }
+
+        M_file = other.M_file;
+        return true;
+    }
+
+    /**
+     * @brief Map the file at the start of a reserved range of
+     *        bytes addresses, so that growing does not move it
+     *        while it fits. Takes effect on the next allocate.
+     *
+     * @param bytes size of the range, 0 to reserve nothing
+     */
+    void
+    reserve_address(size_type bytes)
+    {
+        const auto page = page_size();
+        M_reserve = (bytes + page - 1) / page * page;
+    }
+
+    size_type
+    reserved_address() const
+    {
+        return M_reserve;
+    }
+
+    /**
+     * @brief Ask for the file to be mapped with huge pages. Takes
+     *        effect on the next allocate, memory already given out
+     *        must be deallocated with the same setting.
+     */
+    void
+    use_huge_pages(bool on)
+    {
+        M_huge = on ? huge_page_status::requested : huge_page_status::off;
+    }
+
+    /**
+     * @brief Whether huge pages were asked for and, once mapped,
+     *        whether the system took them.
+     */
+    huge_page_status
+    huge_pages() const
+    {
+        return M_huge;
+    }
+
+    /**
+     * @brief Size of a transparent huge page, 2 MiB where the
+     *        system does not say.
+     */
+    static size_type
+    huge_page_size()
+    {
+        static const size_type size = []
+        {
+            size_type sz = 0;
+            if (FILE* f = ::fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r"))
+            {
+                unsigned long long read = 0;
+                if (::fscanf(f, "%llu", &read) == 1)
+                {
+                    sz = read;
+                }
+                ::fclose(f);
+            }
+
+            return sz ? sz : size_type(2) << 20;
+        }();
+
+        return size;
     }
 
     /**
@@ -232,6 +731,10 @@ public:
         return {mremap(old_addr, sz_old, sz), sz / n};
     }
 
+    /**
+     * @brief Unmap, changes reach the file when the system writes
+     *        them back, use flush to wait for them.
+     */
     void
     deallocate(pointer addr, size_type n)
     {
@@ -241,23 +744,247 @@ public:
             sz_old = page_aligned(n);
         }
 
-        ::msync(addr, sz_old * sizeof(value_type), MS_SYNC);
-        ::munmap(addr, n);
+        unmap(addr, sz_old);
+    }
+
+    /**
+     * @brief Write n T from addr to the file, msync on the pages
+     *        holding them.
+     *
+     * @param addr inside memory returned from allocate
+     * @param n number of T to write
+     * @param wait true to return once written, MS_SYNC, false to
+     *             only schedule the write, MS_ASYNC
+     * @return size_type bytes of the pages given to msync, 0 if
+     *                   it failed or there is no file
+     */
+    size_type
+    flush(pointer addr, size_type n, bool wait)
+    {
+        if (anonymous())
+        {
+            return 0;
+        }
+
+        const auto page  = page_size();
+        const auto begin = reinterpret_cast<std::uintptr_t>(addr) / page * page;
+        const auto end   = reinterpret_cast<std::uintptr_t>(addr + n);
+
+        if (end <= begin)
+        {
+            return 0;
+        }
+
+        if (::msync(reinterpret_cast<void*>(begin), end - begin, wait ? MS_SYNC : MS_ASYNC))
+        {
+            return 0;
+        }
+
+        return (end - begin + page - 1) / page * page;
+    }
+
+    /**
+     * @brief Tell the system how n T from addr will be read.
+     *
+     * @param addr inside memory returned from allocate
+     * @param n number of T
+     * @return false if madvise failed
+     */
+    bool
+    advise(pointer addr, size_type n, access_pattern pattern)
+    {
+        static const int advice[] = { MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL };
+
+        const auto range = page_range(addr, n);
+
+        return range.second == 0 ||
+               ::madvise(range.first, range.second, advice[static_cast<int>(pattern)]) == 0;
+    }
+
+    /**
+     * @brief Fault in the pages holding n T from addr now, rather
+     *        than one at a time on first touch. MADV_POPULATE_READ
+     *        where the system has it, otherwise MADV_WILLNEED to
+     *        start reading and a read of every page.
+     *
+     * @param addr inside memory returned from allocate
+     * @param n number of T
+     */
+    void
+    warmup(pointer addr, size_type n)
+    {
+        const auto range = page_range(addr, n);
+        if (range.second == 0 || ::madvise(range.first, range.second, MADV_POPULATE_READ) == 0)
+        {
+            return;
+        }
+
+        ::madvise(range.first, range.second, MADV_WILLNEED);
+
+        const auto page  = page_size();
+        const auto begin = static_cast<const volatile char*>(range.first);
+        for (size_type at = 0; at < range.second; at += page)
+        {
+            static_cast<void>(begin[at]);
+        }
+    }
+
+    /**
+     * @brief Number of whole T the file holds now, without
+     *        changing the file.
+     *
+     * @return size_type 0 if there is no file
+     */
+    size_type
+    file_size() const
+    {
+        struct stat64 st;
+        if (anonymous() || ::stat64(M_file.c_str(), &st))
+        {
+            return 0;
+        }
+
+        return st.st_size / sizeof(value_type);
+    }
+
+    /**
+     * @brief Make n T from addr read as zero bytes. Whole pages
+     *        are removed from the file, MADV_REMOVE, so they are
+     *        neither written nor kept, the partial pages at either
+     *        end are written. Anonymous pages are dropped,
+     *        MADV_DONTNEED.
+     *
+     * @param addr inside memory returned from allocate
+     * @param n number of T to clear
+     */
+    void
+    clear(pointer addr, size_type n)
+    {
+        const auto page  = page_size();
+        const auto begin = reinterpret_cast<char*>(addr);
+        const auto end   = begin + n * sizeof(value_type);
+        const auto first = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(begin) + page - 1) / page * page);
+        const auto last  = reinterpret_cast<char*>(reinterpret_cast<std::uintptr_t>(end) / page * page);
+
+        if (first >= last)
+        {
+            std::memset(begin, 0, end - begin);
+            return;
+        }
+
+        std::memset(begin, 0, first - begin);
+        std::memset(last, 0, end - last);
+        if (::madvise(first, last - first, anonymous() ? MADV_DONTNEED : MADV_REMOVE))
+        {
+            std::memset(first, 0, last - first);
+        }
     }
 
     void
     wipe()
     {
-        ::remove(M_file.c_str());
+        if (!anonymous())
+        {
+            ::remove(M_file.c_str());
+            M_fd.reset();
+        }
     }
 
 private:
 
-    const std::string M_file;
-    bool              M_least;
+    /**
+     * @brief The pages holding n T from addr, as the start of the
+     *        first and the bytes up to the end of the last.
+     */
+    static std::pair<void*, size_type>
+    page_range(pointer addr, size_type n)
+    {
+        const auto page  = page_size();
+        const auto begin = reinterpret_cast<std::uintptr_t>(addr) / page * page;
+        const auto end   = reinterpret_cast<std::uintptr_t>(addr + n);
+
+        if (end <= begin)
+        {
+            return {nullptr, 0};
+        }
+
+        return {reinterpret_cast<void*>(begin), (end - begin + page - 1) / page * page};
+    }
+
+    std::string          M_file;
+    std::shared_ptr<int> M_fd;
+    bool                 M_least;
+    size_type            M_reserve;
+    void*                M_base;
+    huge_page_status     M_huge;
 
 };
 
+/*  64 GiB, address space only.
+*/
+constexpr std::size_t reserved_mmap_default = std::size_t(1) << 36;
+
+/**
+ * @brief mmap_allocator with reserve_address already called, so
+ *        a container using it keeps its buckets at the same
+ *        address while growing.
+ */
+template<typename T>
+class reserved_mmap_allocator :
+    public mmap_allocator<T>
+{
+public:
+
+    using base = mmap_allocator<T>;
+
+    reserved_mmap_allocator()
+    {
+        this->reserve_address(reserved_mmap_default);
+    }
+
+    reserved_mmap_allocator(std::string&& file) :
+        base(std::move(file))
+    {
+        this->reserve_address(reserved_mmap_default);
+    }
+
+    reserved_mmap_allocator(const std::string& file) :
+        base(file)
+    {
+        this->reserve_address(reserved_mmap_default);
+    }
+};
+
+/**
+ * @brief mmap_allocator with huge pages asked for, for large
+ *        containers whose lookups miss the TLB.
+ */
+template<typename T>
+class huge_mmap_allocator :
+    public mmap_allocator<T>
+{
+public:
+
+    using base = mmap_allocator<T>;
+
+    huge_mmap_allocator()
+    {
+        this->use_huge_pages(true);
+    }
+
+    huge_mmap_allocator(std::string&& file) :
+        base(std::move(file))
+    {
+        this->use_huge_pages(true);
+    }
+
+    huge_mmap_allocator(const std::string& file) :
+        base(file)
+    {
+        this->use_huge_pages(true);
+    }
+};
+
 FILE_NAMESPACE_END
 
 #endif
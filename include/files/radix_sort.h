@@ -0,0 +1,104 @@
+#ifndef CUSTOM_FILE_LIBRARY_RADIX_SORT
+#define CUSTOM_FILE_LIBRARY_RADIX_SORT
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "defs.h"
+
+/*  Least significant digit radix sort of records by an unsigned
+    key, a byte per pass. Stable, so records with equal keys keep
+    their order. Each pass counts the digits of a share of the
+    records per thread, then each thread moves its share to where
+    the counts of the shares before it say.
+*/
+
+FILE_NAMESPACE_BEGIN
+
+/**
+ * @brief Call f(part) for every part in [0,threads), each on a
+ *        thread of its own, part 0 on the calling one.
+ */
+template<typename F>
+void
+in_parallel(std::size_t threads, F f)
+{
+    std::vector<std::thread> running;
+    for (std::size_t part = 1; part < threads; ++part)
+    {
+        running.emplace_back(f, part);
+    }
+
+    f(0);
+    for (auto& thread : running)
+    {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Sort records by key(record), which is less than 2^bits.
+ *
+ * @param threads number of threads, fewer are used when there
+ *                are few records
+ */
+template<typename T, typename KeyOf>
+void
+radix_sort(std::vector<T>& records, KeyOf key, std::size_t bits, std::size_t threads = 1)
+{
+    constexpr std::size_t digit_bits = 8;
+    constexpr std::size_t digits     = std::size_t(1) << digit_bits;
+    constexpr std::size_t min_share  = std::size_t(1) << 16;
+
+    using counts = std::array<std::size_t, digits>;
+
+    const auto size = records.size();
+    threads = std::max<std::size_t>(1, std::min(threads, size / min_share));
+
+    std::vector<T>      sorted(records);
+    std::vector<counts> count(threads);
+    for (std::size_t shift = 0; shift < bits; shift += digit_bits)
+    {
+        in_parallel(threads, [&](std::size_t part)
+        {
+            auto& mine = count[part];
+            mine.fill(0);
+            for (auto i = size * part / threads; i != size * (part + 1) / threads; ++i)
+            {
+                ++mine[(key(records[i]) >> shift) & (digits - 1)];
+            }
+        });
+
+        /*  Turn the counts into where each share puts its first
+            record of each digit.
+        */
+        std::size_t at = 0;
+        for (std::size_t digit = 0; digit != digits; ++digit)
+        {
+            for (auto& mine : count)
+            {
+                const auto n = mine[digit];
+                mine[digit]  = at;
+                at          += n;
+            }
+        }
+
+        in_parallel(threads, [&](std::size_t part)
+        {
+            auto& mine = count[part];
+            for (auto i = size * part / threads; i != size * (part + 1) / threads; ++i)
+            {
+                sorted[mine[(key(records[i]) >> shift) & (digits - 1)]++] = records[i];
+            }
+        });
+
+        records.swap(sorted);
+    }
+}
+
+FILE_NAMESPACE_END
+
+#endif
@@ -0,0 +1,435 @@
+#ifndef CUSTOM_FILE_LIBRARY_SHARDED_MAP
+#define CUSTOM_FILE_LIBRARY_SHARDED_MAP
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "backoff.h"
+#include "defs.h"
+#include "growth_policy.h"
+#include "mmap_allocator.h"
+#include "queue_lock.h"
+#include "unordered_map.h"
+
+/*  Splits keys over Shards separate unordered_map_file, each with
+    a file and a lock of its own. A key goes to the shard picked by
+    the high bits of its mixed hash, the maps below bucket by the
+    hash as is, so the two do not line up.
+
+    A shard is locked for every call into it, so writers on other
+    shards are not held up, neither by each other nor by a resize,
+    which only moves the elements of one shard.
+*/
+
+FILE_NAMESPACE_BEGIN
+
+/**
+ * @brief Thread safe map over Shards unordered_map_file.
+ *
+ * @tparam Shards number of maps the keys are split over
+ * @tparam Lock   lock of a shard, queue_lock or spin_lock
+ *
+ * @note No iterators are given out since they would outlive
+ *       the lock of their shard, use @ref visit or
+ *       @ref for_each_shard.
+ */
+template<
+    typename Key,
+    typename Value,
+    typename Hash = std::hash<Key>,
+    std::size_t Shards = 16,
+    template<typename...> typename Allocator = mmap_allocator,
+    typename Lock = queue_lock<backoff_userspace>>
+class sharded_map_file
+{
+    static_assert(Shards > 0, "Need at least one shard.");
+
+public:
+
+    using map_type    = unordered_map_file<Key, Value, Hash, Allocator>;
+    using size_type   = typename map_type::size_type;
+    using key_type    = Key;
+    using mapped_type = Value;
+
+    static constexpr std::size_t shards = Shards;
+
+private:
+
+    struct shard
+    {
+        template<typename... Args>
+        shard(Args&&... args) :
+            lock(),
+            map(std::forward<Args>(args)...)
+        {
+        }
+
+        mutable Lock lock;
+        map_type     map;
+    };
+
+    using guard = std::lock_guard<Lock>;
+
+    /*  Indices into a batch of keys grouped by shard, those of
+        shard s at [first[s],first[s+1]).
+    */
+    struct grouped
+    {
+        std::vector<size_type>            index;
+        std::array<size_type, Shards + 1> first;
+    };
+
+    template<typename KeyOf>
+    grouped
+    group(size_type n, KeyOf key) const
+    {
+        grouped                  out;
+        std::vector<std::size_t> of(n);
+
+        out.first.fill(0);
+        for (size_type i = 0; i != n; ++i)
+        {
+            of[i] = shard_of(key(i));
+            ++out.first[of[i] + 1];
+        }
+        for (std::size_t s = 0; s != Shards; ++s)
+        {
+            out.first[s + 1] += out.first[s];
+        }
+
+        auto at = out.first;
+        out.index.resize(n);
+        for (size_type i = 0; i != n; ++i)
+        {
+            out.index[at[of[i]]++] = i;
+        }
+
+        return out;
+    }
+
+public:
+
+    /**
+     * @brief Shards on anonymous memory.
+     */
+    sharded_map_file()
+    {
+        M_shards.reserve(Shards);
+        for (std::size_t s = 0; s != Shards; ++s)
+        {
+            M_shards.emplace_back(new shard());
+        }
+    }
+
+    /**
+     * @brief Shard s in the file @ref shard_name (name, s).
+     */
+    sharded_map_file(const std::string& name)
+    {
+        M_shards.reserve(Shards);
+        for (std::size_t s = 0; s != Shards; ++s)
+        {
+            M_shards.emplace_back(new shard(shard_name(name, s)));
+        }
+    }
+
+    /**
+     * @param buckets buckets over all shards
+     * @param preserve see unordered_map_file
+     */
+    sharded_map_file(const std::string& name, size_type buckets, bool preserve)
+    {
+        M_shards.reserve(Shards);
+        for (std::size_t s = 0; s != Shards; ++s)
+        {
+            M_shards.emplace_back(new shard(shard_name(name, s), (buckets + Shards - 1) / Shards, preserve));
+        }
+    }
+
+    static std::string
+    shard_name(const std::string& name, std::size_t s)
+    {
+        return name + "." + std::to_string(s);
+    }
+
+    /**
+     * @brief Shard of a key hashed by Hash.
+     */
+    static std::size_t
+    shard_of_hash(std::size_t hashed)
+    {
+        return mul_high(mix_hash(hashed), Shards);
+    }
+
+    std::size_t
+    shard_of(const Key& k) const
+    {
+        return shard_of_hash(M_hash(k));
+    }
+
+    /**
+     * @brief Sum of the shards, each locked in turn, so not a
+     *        snapshot while other threads write.
+     */
+    size_type
+    size() const
+    {
+        size_type n = 0;
+        for (auto& s : M_shards)
+        {
+            guard lock(s->lock);
+            n += s->map.size();
+        }
+
+        return n;
+    }
+
+    bool
+    empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * @return true if inserted, false if k was already there
+     */
+    template<typename... Args>
+    bool
+    emplace(const Key& k, Args&&... args)
+    {
+        auto& s = *M_shards[shard_of(k)];
+        guard lock(s.lock);
+
+        return s.map.emplace(k, std::forward<Args>(args)...).second;
+    }
+
+    bool
+    insert(const std::pair<Key, Value>& v)
+    {
+        return emplace(v.first, v.second);
+    }
+
+    /**
+     * @return true if inserted, false if assigned
+     */
+    template<typename U>
+    bool
+    insert_or_assign(const Key& k, U&& val)
+    {
+        auto& s = *M_shards[shard_of(k)];
+        guard lock(s.lock);
+
+        return s.map.insert_or_assign(k, std::forward<U>(val)).second;
+    }
+
+    size_type
+    erase(const Key& k)
+    {
+        auto& s = *M_shards[shard_of(k)];
+        guard lock(s.lock);
+
+        return s.map.erase(k);
+    }
+
+    bool
+    contains(const Key& k) const
+    {
+        auto& s = *M_shards[shard_of(k)];
+        guard lock(s.lock);
+
+        return s.map.contains(k);
+    }
+
+    /**
+     * @brief Copy the value of k to out.
+     *
+     * @return false if k is not there, out is left as is
+     */
+    bool
+    find(const Key& k, Value& out) const
+    {
+        return visit(k, [&](const Value& v){ out = v; });
+    }
+
+    /**
+     * @brief Call f(value) of k with its shard locked.
+     *
+     * @return false if k is not there, f is not called
+     */
+    template<typename F>
+    bool
+    visit(const Key& k, F f)
+    {
+        auto& s = *M_shards[shard_of(k)];
+        guard lock(s.lock);
+
+        auto iter = s.map.find(k);
+        if (iter == s.map.end())
+        {
+            return false;
+        }
+
+        f(iter->second);
+        return true;
+    }
+
+    template<typename F>
+    bool
+    visit(const Key& k, F f) const
+    {
+        const auto& s = *M_shards[shard_of(k)];
+        guard lock(s.lock);
+
+        const map_type& map = s.map;
+        auto iter = map.find(k);
+        if (iter == map.cend())
+        {
+            return false;
+        }
+
+        f(iter->second);
+        return true;
+    }
+
+    /**
+     * @brief Insert n pairs, taking the lock of each shard once.
+     *        Threads inserting batches at the same time only
+     *        wait on each other for the shards they share.
+     *
+     * @return number inserted, pairs whose key was already there
+     *         are not
+     */
+    size_type
+    insert_batch(const std::pair<Key, Value>* pairs, size_type n)
+    {
+        const auto by = group(n, [&](size_type i) -> const Key& { return pairs[i].first; });
+
+        size_type inserted = 0;
+        for (std::size_t i = 0; i != Shards; ++i)
+        {
+            if (by.first[i] == by.first[i + 1])
+            {
+                continue;
+            }
+
+            auto& s = *M_shards[i];
+            guard lock(s.lock);
+            for (auto j = by.first[i]; j != by.first[i + 1]; ++j)
+            {
+                const auto& v = pairs[by.index[j]];
+                inserted += s.map.emplace(v.first, v.second).second;
+            }
+        }
+
+        return inserted;
+    }
+
+    /**
+     * @return number erased
+     */
+    size_type
+    erase_batch(const key_type* keys, size_type n)
+    {
+        const auto by = group(n, [&](size_type i) -> const Key& { return keys[i]; });
+
+        size_type erased = 0;
+        for (std::size_t i = 0; i != Shards; ++i)
+        {
+            if (by.first[i] == by.first[i + 1])
+            {
+                continue;
+            }
+
+            auto& s = *M_shards[i];
+            guard lock(s.lock);
+            for (auto j = by.first[i]; j != by.first[i + 1]; ++j)
+            {
+                erased += s.map.erase(keys[by.index[j]]);
+            }
+        }
+
+        return erased;
+    }
+
+    /**
+     * @brief The keys of a shard are looked up together with
+     *        unordered_map_file::contains_batch.
+     *
+     * @param out out[i] is set to contains(keys[i])
+     */
+    void
+    contains_batch(const key_type* keys, size_type n, bool* out) const
+    {
+        const auto by = group(n, [&](size_type i) -> const Key& { return keys[i]; });
+
+        std::vector<key_type>   mine;
+        std::unique_ptr<bool[]> found(new bool[n]);
+        for (std::size_t i = 0; i != Shards; ++i)
+        {
+            if (by.first[i] == by.first[i + 1])
+            {
+                continue;
+            }
+
+            mine.clear();
+            for (auto j = by.first[i]; j != by.first[i + 1]; ++j)
+            {
+                mine.push_back(keys[by.index[j]]);
+            }
+
+            {
+                const auto& s = *M_shards[i];
+                guard lock(s.lock);
+                s.map.contains_batch(mine.data(), mine.size(), found.get());
+            }
+
+            for (auto j = by.first[i]; j != by.first[i + 1]; ++j)
+            {
+                out[by.index[j]] = found[j - by.first[i]];
+            }
+        }
+    }
+
+    /**
+     * @brief Call f(map) for each shard with it locked, for
+     *        what is done to all the maps alike such as sync,
+     *        rehash settings or iterating.
+     */
+    template<typename F>
+    void
+    for_each_shard(F f)
+    {
+        for (auto& s : M_shards)
+        {
+            guard lock(s->lock);
+            f(s->map);
+        }
+    }
+
+    void
+    clear()
+    {
+        for_each_shard([](map_type& map){ map.clear(); });
+    }
+
+    void
+    sync()
+    {
+        for_each_shard([](map_type& map){ map.sync(); });
+    }
+
+private:
+
+    std::vector<std::unique_ptr<shard>> M_shards;
+    Hash                                M_hash;
+};
+
+FILE_NAMESPACE_END
+
+#endif
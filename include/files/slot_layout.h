@@ -0,0 +1,393 @@
+#ifndef CUSTOM_FILE_LIBRARY_SLOT_LAYOUT
+#define CUSTOM_FILE_LIBRARY_SLOT_LAYOUT
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "defs.h"
+#include "file_block.h"
+
+/*  A slot layout decides what is stored in a bucket beside the
+    key and value, and so the size of a bucket. A layout is a
+    stateless type with
+
+        element<Key,Value>  - block type of a bucket
+        value_at            - index of the key value pair in element
+        positional          - true if what is stored depends on the
+                              index of the bucket, it must then be
+                              fixed with set_home when moved to a
+                              different number of buckets
+        max_displacement    - largest distance from the modded hash
+                              an element can be stored at
+        zero_is_free        - true if a bucket of all zero bytes is
+                              free, memory known to be zero then
+                              needs no set_free
+
+    and static functions on an element e
+
+        valid_key(k)        - false if key k cannot be stored
+        is_free(e)
+        set_free(e)
+        construct(p, hash, disp, args...)
+                            - construct a taken element in p, hash
+                              is the stored hash of the key, disp
+                              the distance from its modded hash and
+                              args construct the key value pair
+        hash(e, key_hash)   - stored hash of e, key_hash(key) is
+                              called when the layout does not keep
+                              the hash
+        home(e, index, buckets, reduce, key_hash)
+                            - modded hash of e stored at index
+        matches(e, hash)    - false if e cannot have hash
+        moved(e, to, from, buckets)
+                            - e was copied from index from to index to
+        set_home(e, index, home, buckets)
+*/
+
+FILE_NAMESPACE_BEGIN
+
+/**
+ * @brief Distance walked from home to index, with wrap around.
+ */
+inline std::size_t
+displacement(std::size_t index, std::size_t home, std::size_t buckets)
+{
+    return index >= home ? index - home : index + buckets - home;
+}
+
+/**
+ * @brief Taken flag and the full hash, 2 * sizeof(std::size_t)
+ *        bytes per bucket. The hash never has to be recomputed.
+ *        A free bucket has a zero flag.
+ */
+struct full_hash_layout
+{
+    using size_type = std::size_t;
+
+    template<typename Key, typename Value>
+    using element = block<size_type, size_type, std::pair<const Key, Value>>;
+
+    static constexpr size_type value_at         = 2;
+    static constexpr bool      positional       = false;
+    static constexpr size_type max_displacement = std::numeric_limits<size_type>::max();
+    static constexpr bool      zero_is_free     = true;
+
+    template<typename Key>
+    static bool
+    valid_key(const Key&)
+    {
+        return true;
+    }
+
+    template<typename Elem>
+    static bool
+    is_free(const Elem& e)
+    {
+        return !get<0>(e);
+    }
+
+    template<typename Elem>
+    static void
+    set_free(Elem& e)
+    {
+        get<0>(e) = 0;
+    }
+
+    template<typename Elem, typename... Args>
+    static void
+    construct(Elem* p, size_type hash, size_type, Args&&... args)
+    {
+        set<0>(*p, 1);
+        set<1>(*p, hash);
+        set<2>(*p, std::forward<Args>(args)...);
+    }
+
+    template<typename Elem, typename KeyHash>
+    static size_type
+    hash(const Elem& e, KeyHash)
+    {
+        return get<1>(e);
+    }
+
+    template<typename Elem, typename Reduce, typename KeyHash>
+    static size_type
+    home(const Elem& e, size_type, size_type buckets, Reduce reduce, KeyHash)
+    {
+        return reduce(get<1>(e), buckets);
+    }
+
+    template<typename Elem>
+    static bool
+    matches(const Elem& e, size_type hash)
+    {
+        return get<1>(e) == hash;
+    }
+
+    template<typename Elem>
+    static void
+    moved(Elem&, size_type, size_type, size_type)
+    {
+    }
+
+    template<typename Elem>
+    static void
+    set_home(Elem&, size_type, size_type, size_type)
+    {
+    }
+};
+
+/**
+ * @brief Taken bit, displacement and fingerprint packed into a
+ *        single Word. The home of an element is its index minus
+ *        its displacement, so the order of a cluster is known
+ *        without the hash. The hash is recomputed from the key
+ *        on rehash.
+ *
+ *        Bits of Word, low to high
+ *          1           taken
+ *          half - 1    displacement
+ *          half        fingerprint, bits of the hash
+ *
+ *        A free bucket is all zero. More than max_displacement + 1
+ *        keys sharing a hash cannot be stored, inserting the next
+ *        throws std::length_error.
+ *
+ * @tparam Word std::uint32_t or std::uint64_t
+ */
+template<typename Word = std::uint32_t>
+struct compact_layout
+{
+    static_assert(std::is_unsigned<Word>::value && sizeof(Word) >= 4,
+                  "word must be unsigned and at least 32 bits");
+
+    using size_type = std::size_t;
+    using word_type = Word;
+
+    /*  The pair is stored right after the word, a word narrower
+        than the alignment of the pair is stored as 64 bits so
+        the pair is aligned. The bits above Word stay zero.
+    */
+    template<typename Key, typename Value>
+    struct stored_word
+    {
+        static_assert(alignof(std::pair<const Key, Value>) <= alignof(std::uint64_t),
+                      "pair must not need more than 64 bit alignment");
+
+        using type = typename std::conditional<
+            (alignof(std::pair<const Key, Value>) > sizeof(word_type)),
+            std::uint64_t,
+            word_type>::type;
+    };
+
+    template<typename Key, typename Value>
+    using element = block<typename stored_word<Key, Value>::type, std::pair<const Key, Value>>;
+
+    static constexpr unsigned half = sizeof(word_type) * 4;
+
+    static constexpr size_type value_at         = 1;
+    static constexpr bool      positional       = true;
+    static constexpr size_type max_displacement = (size_type(1) << (half - 1)) - 1;
+    static constexpr bool      zero_is_free     = true;
+
+    /**
+     * @brief Fingerprint of a hash, folds the high half into the
+     *        low half so reductions using either still leave
+     *        differing bits.
+     */
+    static word_type
+    fingerprint(size_type hash)
+    {
+        return static_cast<word_type>((hash ^ (hash >> 32)) & ((size_type(1) << half) - 1));
+    }
+
+    template<typename Key>
+    static bool
+    valid_key(const Key&)
+    {
+        return true;
+    }
+
+    template<typename Elem>
+    static bool
+    is_free(const Elem& e)
+    {
+        return !(get<0>(e) & 1);
+    }
+
+    template<typename Elem>
+    static void
+    set_free(Elem& e)
+    {
+        get<0>(e) = 0;
+    }
+
+    template<typename Elem, typename... Args>
+    static void
+    construct(Elem* p, size_type hash, size_type disp, Args&&... args)
+    {
+        const word_type header = 1
+            | static_cast<word_type>(disp << 1)
+            | static_cast<word_type>(fingerprint(hash) << half);
+        set<0>(*p, header);
+        set<1>(*p, std::forward<Args>(args)...);
+    }
+
+    template<typename Elem, typename KeyHash>
+    static size_type
+    hash(const Elem& e, KeyHash key_hash)
+    {
+        return key_hash(get<1>(e).first);
+    }
+
+    template<typename Elem, typename Reduce, typename KeyHash>
+    static size_type
+    home(const Elem& e, size_type index, size_type buckets, Reduce, KeyHash)
+    {
+        const size_type disp = get_disp(e);
+        return index >= disp ? index - disp : index + buckets - disp;
+    }
+
+    template<typename Elem>
+    static bool
+    matches(const Elem& e, size_type hash)
+    {
+        return (get<0>(e) >> half) == fingerprint(hash);
+    }
+
+    template<typename Elem>
+    static void
+    moved(Elem& e, size_type to, size_type from, size_type buckets)
+    {
+        auto disp = get_disp(e) + displacement(to, from, buckets);
+        if (disp >= buckets)
+        {
+            disp -= buckets;
+        }
+
+        set_disp(e, disp);
+    }
+
+    template<typename Elem>
+    static void
+    set_home(Elem& e, size_type index, size_type home, size_type buckets)
+    {
+        set_disp(e, displacement(index, home, buckets));
+    }
+
+private:
+
+    static constexpr word_type disp_mask = static_cast<word_type>(max_displacement << 1);
+
+    template<typename Elem>
+    static size_type
+    get_disp(const Elem& e)
+    {
+        return (get<0>(e) & disp_mask) >> 1;
+    }
+
+    template<typename Elem>
+    static void
+    set_disp(Elem& e, size_type disp)
+    {
+        get<0>(e) = (get<0>(e) & ~disp_mask) | (static_cast<word_type>(disp << 1) & disp_mask);
+    }
+};
+
+/**
+ * @brief Nothing but the key and value. A free bucket holds the
+ *        key Empty, inserting it throws std::invalid_argument.
+ *        The hash is recomputed from the key whenever it is
+ *        needed, which is cheap for integral keys. An Empty of 0
+ *        lets new memory be used without writing it.
+ *
+ * @tparam Key integral key type
+ * @tparam Empty key marking a free bucket
+ */
+template<typename Key, Key Empty = std::numeric_limits<Key>::max()>
+struct sentinel_layout
+{
+    static_assert(std::is_integral<Key>::value, "sentinel key must be integral");
+
+    using size_type = std::size_t;
+
+    template<typename K, typename Value>
+    using element = block<std::pair<const K, Value>>;
+
+    static constexpr size_type value_at         = 0;
+    static constexpr bool      positional       = false;
+    static constexpr size_type max_displacement = std::numeric_limits<size_type>::max();
+    static constexpr bool      zero_is_free     = Empty == 0;
+
+    static bool
+    valid_key(const Key& k)
+    {
+        return k != Empty;
+    }
+
+    template<typename Elem>
+    static bool
+    is_free(const Elem& e)
+    {
+        return get<0>(e).first == Empty;
+    }
+
+    /*  The pair was destroyed or never built, only the key
+        is built into its storage. The key of a free bucket is
+        never read as an element.
+    */
+    template<typename Elem>
+    static void
+    set_free(Elem& e)
+    {
+        ::new (static_cast<void*>(const_cast<Key*>(std::addressof(get<0>(e).first)))) Key(Empty);
+    }
+
+    template<typename Elem, typename... Args>
+    static void
+    construct(Elem* p, size_type, size_type, Args&&... args)
+    {
+        set<0>(*p, std::forward<Args>(args)...);
+    }
+
+    template<typename Elem, typename KeyHash>
+    static size_type
+    hash(const Elem& e, KeyHash key_hash)
+    {
+        return key_hash(get<0>(e).first);
+    }
+
+    template<typename Elem, typename Reduce, typename KeyHash>
+    static size_type
+    home(const Elem& e, size_type, size_type buckets, Reduce reduce, KeyHash key_hash)
+    {
+        return reduce(key_hash(get<0>(e).first), buckets);
+    }
+
+    template<typename Elem>
+    static bool
+    matches(const Elem&, size_type)
+    {
+        return true;
+    }
+
+    template<typename Elem>
+    static void
+    moved(Elem&, size_type, size_type, size_type)
+    {
+    }
+
+    template<typename Elem>
+    static void
+    set_home(Elem&, size_type, size_type, size_type)
+    {
+    }
+};
+
+FILE_NAMESPACE_END
+
+#endif
@@ -1,22 +1,38 @@
 #ifndef CUSTOM_FILE_LIBRARY_UNORDEREDMAPFILE
 #define CUSTOM_FILE_LIBRARY_UNORDEREDMAPFILE
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <initializer_list>
+#include <iterator>
 #include <limits>
 #include <stdlib.h>
 #include <time.h>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <unistd.h>
 #include <vector>
 
 #include "mmap_allocator.h"
+#include "access_pattern.h"
 #include "bidirectional_openaddr.h"
+#include "bitmap.h"
+#include "control_group.h"
 #include "defs.h"
+#include "durability.h"
 #include "file_block.h"
+#include "file_header.h"
+#include "growth_policy.h"
+#include "radix_sort.h"
+#include "slot_layout.h"
+#include "write_ahead_log.h"
 
 /*  NOTE: use open addressing with linear probing
 
@@ -137,10 +153,30 @@ void destruct_is_wipe(T& t, bool b)
 }
 
 /**
- * @brief Increment with wrap around around mod.
+ * @brief Check whether a hash declares is_transparent. Lookups
+ *        then accept any type which the hash and key equality
+ *        accept, not only the key type.
+ *
+ * @tparam Hash hash type to check
+ */
+template<typename Hash, typename = void>
+struct hash_is_transparent :
+    std::false_type
+{
+};
+
+template<typename Hash>
+struct hash_is_transparent<Hash, typename std::conditional<true, void, typename Hash::is_transparent>::type> :
+    std::true_type
+{
+};
+
+/**
+ * @brief Increment with wrap around around mod. Branch free
+ *        and without a division, called on every probe.
  * 
  * @tparam Sz unsigned type
- * @param i num to increment
+ * @param i num to increment, in range [0,mod)
  * @param mod modulus
  * @return Sz a value in range [0,mod)
  */
@@ -150,14 +186,16 @@ template<
 void
 increment_wrap(Sz& i, Sz mod)
 {
-    i = (i + mod + 1) % mod;
+    ++i;
+    i *= (i != mod);
 }
 
 /**
- * @brief Decrememnt with wrap around around mod
+ * @brief Decrememnt with wrap around around mod. Branch free
+ *        and without a division.
  * 
  * @tparam Sz unsigned type
- * @param i num to decrement
+ * @param i num to decrement, in range [0,mod)
  * @param mod modulus
  * @return Sz a value in range [0,mod)
  */
@@ -167,7 +205,8 @@ template<
 void
 decrement_wrap(Sz& i, Sz mod)
 {
-    i = (i + mod - 1) % mod;
+    i += mod * (i == 0);
+    --i;
 }
 
 /**
@@ -179,25 +218,30 @@ decrement_wrap(Sz& i, Sz mod)
  * @tparam IsFree(curr) true if the curr index be used written into
  *                      without overriding old data, otherwise false
  * @tparam HashComp(curr,against) comparison of modded hash values of curr
- *                                index with against index. return
+ *                                index with against index. modded means
+ *                                reduced to a bucket, not necessarily %.
+ *                                return
  *                                0) curr < against
  *                                1) curr == against
  *                                2) curr > against
  * @tparam KeyComp(curr,k) true if key at curr index a k compare equal,
  *                         false otherwise
  * @tparam HashEq(curr,num) compairson of modded hash values of
- *                          curr index with number num
+ *                          curr index with number num, in probe
+ *                          order from curr so that a wrapped
+ *                          cluster compares the same way
  *                          0) curr < num
  *                          1) curr = num
  *                          2) curr > num
  * @param cont container to search
  * @param k key to look for
- * @param key_hash key hash, will begin searching from (key_hash % buckets)
+ * @param home modded key hash in range [0,buckets), will begin
+ *             searching from here
  * @param buckets numbers of buckets. assume this to equal to one plus the
  *                maximum valid index in cont (ie maximum number of elements)
  *                ie the wrap around value for iteration
  * @return std::pair<Sz, bool> Sz   - (A) found index of key
- *                                    (B) first free index at or after key_hash // NOTE this is wrong, should be first insertable / free
+ *                                    (B) first free index at or after home // NOTE this is wrong, should be first insertable / free
  *                             bool - (A) true if found
  *                                    (B) false if not found
  */
@@ -207,9 +251,9 @@ template<
     typename IsFree, typename HashComp, typename KeyComp,
     typename HashEq>
 std::pair<Sz, bool>
-open_address_find(const Container& cont, const Key& k, Sz key_hash, Sz buckets)
+open_address_find(const Container& cont, const Key& k, Sz home, Sz buckets)
 {   
-    auto index    = key_hash % buckets;
+    auto index    = home;
     bool iterated = false;
 
     /*  Collision overflow past end. Will not find the key
@@ -228,7 +272,7 @@ open_address_find(const Container& cont, const Key& k, Sz key_hash, Sz buckets)
             - the starting index of the overflow
     */
     if (IsFree()(cont, index) ||
-        (iterated && index == (key_hash % buckets)))
+        (iterated && index == home))
     {
         return { index,false };
     }
@@ -243,7 +287,7 @@ open_address_find(const Container& cont, const Key& k, Sz key_hash, Sz buckets)
     */
     Sz iterations = 0;
     while (!IsFree()(cont, index) &&
-           HashEq()(cont, index, key_hash % buckets) == 0 &&
+           HashEq()(cont, index, home) == 0 &&
            iterations != buckets)
     {
         increment_wrap(index, buckets);
@@ -259,7 +303,7 @@ open_address_find(const Container& cont, const Key& k, Sz key_hash, Sz buckets)
             - same element as started at
     */
     if (IsFree()(cont, index) ||
-        HashEq()(cont, index, key_hash % buckets) == 2 ||
+        HashEq()(cont, index, home) == 2 ||
         iterations == buckets)
     {
         return { index,false };
@@ -286,11 +330,57 @@ open_address_find(const Container& cont, const Key& k, Sz key_hash, Sz buckets)
     return { index, false };
 }
 
+/**
+ * @brief First free index at or after index. There must be a
+ *        free index.
+ */
+template<
+    typename Container,
+    typename Sz,
+    typename IsFree>
+Sz
+open_address_next_free(const Container& cont, Sz index, Sz buckets)
+{
+    for (; !IsFree()(cont, index);)
+    {
+        increment_wrap(index, buckets);
+    }
+
+    return index;
+}
+
+/**
+ * @brief Move every element in [index,free) forward by one,
+ *        leaving index to be written into.
+ *
+ * @tparam ElemTransfer(into,from) put contents of index "from" into index "into"
+ * @param index index to make room at
+ * @param free free index at or after index
+ */
+template<
+    typename Container,
+    typename Sz,
+    typename ElemTransfer>
+void
+open_address_shift(Container& cont, Sz index, Sz free, Sz buckets)
+{
+    for (; free != index;)
+    {
+        auto decrement = free;
+        decrement_wrap(decrement, buckets);
+        ElemTransfer()(cont, free, decrement);
+        free = decrement;
+    }
+}
+
 /**
  * @brief Open addressing insert algorithm. See \ref open_address_find for
  *        docs which would be redundant here.
  *
  * @tparam ElemTransfer(into,from) put contents of index "from" into index "into"
+ * @param probe if not null and inserted, set to the distance from
+ *              the modded key hash to the free index which was
+ *              taken. That is the longest walk done by the insert
  * @return std::pair<Sz,bool> Sz   - (A) index of insertion
  *                                   (B) index of existing key
  *                            bool - (A) true if inserted
@@ -302,14 +392,15 @@ template<
     typename IsFree, typename HashComp, typename KeyComp, typename ElemTransfer,
     typename HashEq>
 std::pair<Sz, bool>
-open_address_emplace_index(Container& cont, const Key& k, Sz key_hash, Sz buckets)
+open_address_emplace_index(Container& cont, const Key& k, Sz home, Sz buckets,
+                           Sz* probe = nullptr)
 {
     auto res = open_address_find<
         Container,
         Key, Sz,
         IsFree, HashComp, KeyComp,
         HashEq>
-    (cont, k, key_hash, buckets);
+    (cont, k, home, buckets);
 
     auto index = res.first;
 
@@ -318,22 +409,15 @@ open_address_emplace_index(Container& cont, const Key& k, Sz key_hash, Sz bucket
         return { index,false };
     }
 
-    if (!IsFree()(cont, index))
+    const auto free = open_address_next_free<Container, Sz, IsFree>(cont, index, buckets);
+
+    if (probe)
     {
-        auto temp = index;
-        for (; !IsFree()(cont, index);)
-        {
-            increment_wrap(index, buckets);
-        }
-        for (; index != temp;)
-        {
-            auto decrement = index;
-            decrement_wrap(decrement, buckets);
-            ElemTransfer()(cont, index, decrement);
-            decrement_wrap(index, buckets);
-        }
+        *probe = free >= home ? free - home : free + buckets - home;
     }
 
+    open_address_shift<Container, Sz, ElemTransfer>(cont, index, free, buckets);
+
     return { index,true };
 }
 
@@ -351,14 +435,14 @@ template<
     typename IsFree, typename HashComp, typename KeyComp, typename ElemTransfer,
     typename HashEq, typename Deconstruct>
 Sz
-open_address_erase_index(Container& cont, const Key& k, Sz key_hash, Sz buckets)
+open_address_erase_index(Container& cont, const Key& k, Sz home, Sz buckets)
 {
     auto res = open_address_find<
         Container,
         Key, Sz,
         IsFree, HashComp, KeyComp,
         HashEq>
-    (cont, k, key_hash, buckets);
+    (cont, k, home, buckets);
 
     if (!res.second)
     {
@@ -427,11 +511,41 @@ open_address_erase_index(Container& cont, const Key& k, Sz key_hash, Sz buckets)
     https://stackoverflow.com/questions/38721618/why-does-stdstack-not-use-template-template-parameter
 */
 
+/*  Growth is a growth policy, see growth_policy.h. It picks the
+    number of buckets once the bucket choices run out, and how a
+    hash is reduced to a bucket.
+
+    Control is true to keep control bytes, see control_group.h,
+    beside the buckets. find then scans the control bytes a group
+    at a time and only reads buckets whose control byte matches.
+    The control bytes are not part of the file, they are rebuilt
+    from the buckets when the container is created or rehashed.
+    An occupancy bitmap, see bitmap.h, is kept the same way so
+    iterators skip 64 free buckets at a time. It is only built the
+    first time it is needed, so opening a container does not look
+    at every bucket.
+
+    When the allocator is backed by a file a header, see
+    file_header.h, is kept in front of the buckets. Opening a file
+    with preserve reads the number of buckets and elements from it.
+
+    Layout is a slot layout, see slot_layout.h. It decides what is
+    stored in a bucket beside the key and value. full_hash_layout
+    keeps the full hash, compact_layout packs the taken flag, the
+    distance from the modded hash and a fingerprint of the hash into
+    one word. full_hash_layout is the default for every key.
+    sentinel_layout stores nothing but the key and value and must be
+    asked for explicitly, the largest key cannot be inserted with it.
+*/
+
 template<
     typename Key,
     typename Value,
     typename Hash = std::hash<Key>,
-    template<typename...> typename Allocator = mmap_allocator>
+    template<typename...> typename Allocator = mmap_allocator,
+    typename Growth = prime_growth_policy<>,
+    bool Control = false,
+    typename Layout = full_hash_layout>
 class unordered_map_file
 {
 public:
@@ -441,7 +555,7 @@ public:
 
         potential performance issue
     */
-    using element = block<std::size_t, std::size_t, std::pair<const Key, Value>>;
+    using element = typename Layout::template element<Key, Value>;
 
     using allocator = Allocator<element>;
 
@@ -459,19 +573,44 @@ public:
     using const_pointer_key   = const Key*;
     using mapped_type         = Value;
 
+    using reduce = typename Growth::reduce;
+
+    /**
+     * @brief Hash of a key as stored in the container.
+     */
+    struct key_hasher
+    {
+        template<typename K>
+        size_type
+        operator()(const K& k) const
+        {
+            return reduce().mix(Hash()(k));
+        }
+    };
+
     struct access
     {
 
         access() = delete;
 
         access(element* ptr) :
-            M_ptr(ptr)
+            M_ptr(ptr),
+            M_buckets(0),
+            M_ctrl(nullptr)
         {
         }
 
         access(element* ptr, size_type buckets) :
             M_ptr(ptr),
-            M_buckets(buckets)
+            M_buckets(buckets),
+            M_ctrl(nullptr)
+        {
+        }
+
+        access(element* ptr, size_type buckets, unsigned char* ctrl) :
+            M_ptr(ptr),
+            M_buckets(buckets),
+            M_ctrl(ctrl)
         {
         }
 
@@ -490,45 +629,100 @@ public:
         }
 
         /**
-         * @brief set free state of index
+         * @brief Mark index as free.
+         *
+         * @param index
+         */
+        void
+        set_free(size_type index)
+        {
+            Layout::set_free(block(index));
+            set_ctrl(index, control_empty);
+        }
+
+        /**
+         * @brief Set the control byte of index, does nothing
+         *        when there are no control bytes.
          *
          * @param index
-         * @param free true for free, false otherwise
+         * @param ctrl see control_group.h
          */
         void
-        set_free(size_type index, bool free)
+        set_ctrl(size_type index, unsigned char ctrl)
+        {
+            if (!M_ctrl)
+            {
+                return;
+            }
+
+            M_ctrl[index] = ctrl;
+
+            /*  Bytes past the end mirror the beginning so that
+                a group can be loaded from any index.
+            */
+            for (auto mirror = index + M_buckets;
+                 mirror < M_buckets + control_group::width - 1;
+                 mirror += M_buckets)
+            {
+                M_ctrl[mirror] = ctrl;
+            }
+        }
+
+        void
+        move_ctrl(size_type to, size_type from)
         {
-            get<0>(block(index)) = free;
+            if (M_ctrl)
+            {
+                set_ctrl(to, M_ctrl[from]);
+            }
         }
 
         bool
         is_free(size_type index) const
         {
-            return get<0>(block(index));
+            return Layout::is_free(block(index));
         }
 
-        size_type&
-        hash(size_type index)
+        /**
+         * @brief Hash of index as given by @ref key_hasher.
+         *        Recomputed from the key when the layout does
+         *        not store it.
+         */
+        size_type
+        hash(size_type index) const
         {
-            return get<1>(block(index));
+            return Layout::hash(block(index), key_hasher());
         }
 
+        /**
+         * @brief Modded hash of index, the bucket the element
+         *        at index hashes to.
+         */
         size_type
-        hash(size_type index) const
+        home(size_type index) const
+        {
+            return Layout::home(block(index), index, M_buckets, reduce(), key_hasher());
+        }
+
+        /**
+         * @brief false if the element at index cannot have hash.
+         */
+        bool
+        matches(size_type index, size_type hash) const
         {
-            return get<1>(block(index));
+            return Layout::matches(block(index), hash);
         }
 
         const_reference_key
         key(size_type index) const
         {
-            return get<2>(block(index)).first;
+            return get<Layout::value_at>(block(index)).first;
         }
 
         reference
         value_type(size_type index)
         {
-            return get<2>(block(index));
+            return get<Layout::value_at>(block(index));
         }
 
         size_type
@@ -537,8 +731,9 @@ public:
             return M_buckets;
         }
 
-        element*  M_ptr;
-        size_type M_buckets;
+        element*       M_ptr;
+        size_type      M_buckets;
+        unsigned char* M_ctrl;
     };
 
     struct convert
@@ -546,7 +741,7 @@ public:
         pointer
         operator()(element* blk)
         {
-            return static_cast<pointer>(std::addressof(get<2>(*blk)));
+            return static_cast<pointer>(std::addressof(get<Layout::value_at>(*blk)));
         }
     };
 
@@ -564,8 +759,8 @@ public:
         size_type
         operator()(access cont, size_type curr, size_type against) const
         {
-            const auto modded_curr    = cont.hash(curr) % cont.buckets();
-            const auto modded_against = cont.hash(against) % cont.buckets();
+            const auto modded_curr    = cont.home(curr);
+            const auto modded_against = cont.home(against);
 
             return (modded_curr >= modded_against) * (1 + (modded_curr > modded_against));
         }
@@ -574,10 +769,8 @@ public:
     template<typename K>
     struct key_comp
     {
-        /*  NOTE: should this be a perfect forward ?
-        */
         bool
-        operator()(access cont, size_type curr, K k) const
+        operator()(access cont, size_type curr, const K& k) const
         {
             return cont.key(curr) == k;
         }
@@ -589,16 +782,23 @@ public:
         operator()(access cont, size_type to, size_type from)
         {
             cont.block(to) = cont.block(from); 
+            Layout::moved(cont.block(to), to, from, cont.buckets());
+            cont.move_ctrl(to, from);
         }
     };
 
+    /*  Compares how far curr is from its modded hash and from
+        num rather than the two numbers, a cluster which wraps
+        around the end still reads in order.
+    */
     struct hash_eq
     {
         size_type operator()(access cont, size_type curr, size_type num)
         {
-            const auto modded_curr = cont.hash(curr) % cont.buckets();
+            const auto from_home = displacement(curr, cont.home(curr), cont.buckets());
+            const auto from_num  = displacement(curr, num, cont.buckets());
 
-            return (modded_curr >= num) * (1 + (modded_curr > num));
+            return (from_home <= from_num) * (1 + (from_home < from_num));
         }
     };
 
@@ -606,7 +806,7 @@ public:
     {
         bool operator()(element* ptr)
         {
-            return get<0>(*ptr);
+            return Layout::is_free(*ptr);
         }
     };
 
@@ -636,8 +836,9 @@ private:
      * @param larger true if want next larger size, false for
      *               next smaller
      * @return size_type next preffered size if can. otherwise
-     *                   minimum buckets accounted for load factor
-     *                   or max_size() + 1 if invalid params
+     *                   the growth policy size for the minimum
+     *                   buckets accounted for load factor or
+     *                   max_size() + 1 if invalid params
      */
     size_type
     next_size(size_type wanted_buckets, float mlf, bool larger)
@@ -653,217 +854,2010 @@ private:
             return max_sz + 1;
         }
 
-        size_type min_buckets = wanted_buckets / mlf;
+        const size_type min_buckets = std::ceil(wanted_buckets / static_cast<double>(mlf));
         if (larger)
         {
             for (size_type potential : M_bucket_choices)
             {
-                if (potential >= min_buckets)
+                if (potential >= min_buckets && reduce().fits(potential))
                 {
                     return potential;
                 }
             }
+
+            /*  Past the last choice. Let the policy pick so
+                that growth stays geometric rather than one
+                bucket at a time.
+            */
+            const auto policy = Growth().next(min_buckets);
+            return policy > max_sz ? max_sz + 1 : policy;
         }
-        else
+
+        /*  Never fewer buckets than the elements need, whatever
+            is asked for.
+        */
+        const size_type needed = std::ceil(M_elem / static_cast<double>(mlf));
+        const auto      holds  = [&](size_type potential)
+        {
+            return potential >= needed && potential != 0 && reduce().fits(potential);
+        };
+
+        if (!M_bucket_choices.empty() &&
+            min_buckets <= M_bucket_choices.back())
         {
             for (auto iter = M_bucket_choices.crbegin();
                  iter != M_bucket_choices.crend(); ++iter)
             {
-                if (*iter <= min_buckets)
+                if (*iter <= min_buckets && holds(*iter))
                 {
                     return *iter;
                 }
             }
+
+            if (holds(min_buckets))
+            {
+                return min_buckets;
+            }
+        }
+
+        const auto policy = Growth().prev(min_buckets);
+        if (holds(policy))
+        {
+            return policy;
         }
 
-        return min_buckets;
+        const auto least = Growth().next(needed);
+        return least > max_sz ? max_sz + 1 : least;
+    }
+
+    access
+    make_access()
+    {
+        return access(M_file, M_buckets, Control ? M_ctrl.data() : nullptr);
     }
 
     /**
-     * @brief Reserves elements according to @ref next_size
-     * 
-     * @param buckets number of requested buckets
-     * @param mlf max load factor
-     * @param realloc true to reallocate existing memory, false to
-     *                allocate new memory
-     * @return true reserved more space
-     * @return false failed to reserve space
+     * @brief Make the occupancy bitmap and the control bytes
+     *        match the buckets.
      */
-    bool
-    reserve_choice(size_type buckets,
-                   float mlf,
-                   bool realloc,
-                   bool preserve,
-                   bool larger)
+    void
+    rebuild_meta()
     {
-        auto new_buckets = next_size(buckets, mlf, larger);
-        if (new_buckets != max_size() + 1)
+        M_bits.clear();
+        M_bits_built = false;
+
+        if (!Control)
         {
-            if (realloc)
-            {
-                M_file  = M_alloc.reallocate(M_file, M_buckets, new_buckets);
-            }
-            else
+            return;
+        }
+
+        M_ctrl.assign(M_buckets + control_group::width - 1, control_empty);
+
+        auto temp = make_access();
+        for (size_type index = 0; index != M_buckets; ++index)
+        {
+            if (!temp.is_free(index))
             {
-                M_file  = M_alloc.allocate(new_buckets);
+                temp.set_ctrl(index, control_hash(temp.hash(index)));
             }
+        }
+    }
 
-            if (larger)
+    /**
+     * @brief The occupancy bitmap, built from the buckets if it
+     *        has not been yet.
+     */
+    const std::uint64_t*
+    bits() const
+    {
+        if (!M_bits_built)
+        {
+            M_bits.assign(bitmap_words(M_buckets), 0);
+
+            const access temp(M_file, M_buckets);
+            for (size_type index = 0; index != M_buckets; ++index)
             {
-                if (preserve)
-                {
-                    for (; M_buckets != new_buckets; ++M_buckets)
-                    {
-                        if (!access(M_file).is_free(M_buckets))
-                        {
-                            ++M_elem;
-                        }
-                    }
-                }
-                else
+                if (!temp.is_free(index))
                 {
-                    for (; M_buckets != new_buckets; ++M_buckets)
-                    {
-                        access(M_file).set_free(M_buckets, true);
-                    }
+                    bitmap_set(M_bits.data(), index);
                 }
             }
-            else
-            {
-                M_buckets = new_buckets;
-            }
 
-            return true;
+            M_first      = 0;
+            M_bits_built = true;
         }
 
-        return false;
+        return M_bits.data();
     }
 
-    iterator
-    make_iter(size_type index)
+    /**
+     * @brief Index of the first taken bucket, number of buckets
+     *        if there is none. Nothing is taken before M_first,
+     *        so only the words from there are looked at and
+     *        M_first is moved up to the result.
+     */
+    size_type
+    first_index() const
     {
-        return iterator(M_file + index, M_file + M_buckets);
+        const auto data = bits();
+        M_first = bitmap_next(data, M_first, M_buckets);
+        return M_first;
     }
 
-    const_iterator
-    make_iter(size_type index) const
+    /**
+     * @brief Number of buckets the header takes in front of the
+     *        buckets, 0 when the allocator is not backed by a file.
+     */
+    static size_type
+    header_slots()
     {
-        return const_iterator(M_file + index, M_file + M_buckets);
+        return is_file_backed<allocator>::value
+            ? (file_header_bytes + sizeof(element) - 1) / sizeof(element)
+            : 0;
     }
 
-public:
-
-    unordered_map_file() :
-        M_buckets(0), M_elem(0),
-        M_alloc(),
-        M_delete(false),
-        M_load(1)
+    static std::uint64_t
+    fingerprint()
     {
-        reserve_choice(0, M_load, false, false, true);
+        return type_fingerprint<Key, Value, Hash, Layout, reduce>();
     }
 
-    unordered_map_file(size_type buckets) :
-        M_buckets(0), M_elem(0),
-        M_alloc(),
-        M_delete(false),
-        M_load(1)
+    /**
+     * @brief Write the header of the file, does nothing when
+     *        not backed by a file.
+     *
+     * @param clean true if the container is being closed
+     */
+    void
+    store_header(bool clean)
     {
-        reserve_choice(buckets, M_load, false, false, true);
-    }
+        if (!header_slots() || !M_file)
+        {
+            return;
+        }
 
-    unordered_map_file(std::string name) :
-        M_buckets(0), M_elem(0),
-        M_alloc(std::move(name)),
-        M_delete(false),
-        M_load(1)
-    {
-        reserve_choice(0, M_load, false, false, true);
+        auto h = reinterpret_cast<file_header*>(M_file - header_slots());
+        h->magic        = file_header_magic;
+        h->version      = file_header_version;
+        h->clean        = clean;
+        h->fingerprint  = fingerprint();
+        h->element_size = sizeof(element);
+        h->buckets      = M_buckets;
+        h->elements     = M_elem;
+        h->max_probe    = M_probe;
+        h->seed         = 0;
+        h->load         = M_load;
+        h->num_choices  = std::min(M_bucket_choices.size(), file_header_choices);
+        std::copy(M_bucket_choices.begin(), M_bucket_choices.begin() + h->num_choices, h->choices);
     }
 
-    unordered_map_file(std::string name, size_type buckets, bool preserve) :
-        M_buckets(0), M_elem(0),
-        M_alloc(std::move(name)),
-        M_delete(false),
-        M_load(1)
+    /**
+     * @brief Map an existing file as its header describes. The
+     *        elements are only counted if the file was not
+     *        closed.
+     *
+     * @return false if there is no file
+     */
+    bool
+    open_file()
     {
-        reserve_choice(buckets, M_load, false, true, true);
+        return open_file(is_file_backed<allocator>());
     }
 
-    unordered_map_file(size_type buckets, std::string name) :
-        M_buckets(0), M_elem(0),
-        M_alloc(std::move(name)),
-        M_delete(false),
-        M_load(1)
+    /**
+     * @brief Not backed by a file, there is nothing to open.
+     */
+    bool
+    open_file(std::false_type)
     {
-        reserve_choice(buckets, M_load, false, false, true);
+        return false;
     }
 
-    unordered_map_file(
-        size_type buckets,
-        std::string name,
-        std::initializer_list<size_type> choices = {}
-    ) :
-        M_buckets(0), M_elem(0),
-        M_alloc(std::move(name)),
-        M_delete(false),
-        M_load(1)
+    bool
+    open_file(std::true_type)
     {
-        if (choices.size())
+        const auto slots = header_slots();
+        const auto total = M_alloc.file_size();
+        if (total == 0)
         {
-            bucket_choices(choices);
+            return false;
         }
 
-        reserve_choice(buckets, M_load, false, false, true);
-    }
-
-    unordered_map_file(unordered_map_file&& rv) :
-        M_buckets(rv.M_buckets), M_elem(rv.M_elem),
-        M_alloc(rv.M_alloc),
-        M_delete(rv.M_delete),
-        M_load(rv.M_load),
-        M_file(rv.M_file)
-    {
-        rv.M_file = nullptr;
-    }
-
-    ~unordered_map_file()
-    {
-        if (M_file)
+        auto base = M_alloc.allocate(total);
+        if (!allocated(base))
         {
-            std::allocator_traits<allocator>::deallocate
-            (
-                M_alloc,
-                M_file,
-                M_buckets
-            );
+            throw std::runtime_error("could not map the file");
         }
 
-        if (M_delete)
+        const auto h = reinterpret_cast<const file_header*>(base);
+        if (total < slots                          ||
+            h->magic        != file_header_magic   ||
+            h->version      != file_header_version ||
+            h->fingerprint  != fingerprint()       ||
+            h->element_size != sizeof(element)     ||
+            h->buckets      >  total - slots       ||
+            h->num_choices  >  file_header_choices)
         {
-            M_alloc.wipe();
+            std::allocator_traits<allocator>::deallocate(M_alloc, base, total);
+            throw std::runtime_error("file was not written by a container of this type");
         }
-    }
 
-    Value& operator[](const Key& k)
-    {
-        auto iter = find(k);
-        if (iter != end())
-        {
-            return iter->second;
-        }
+        M_buckets = h->buckets;
+        M_load    = h->load;
+        M_probe   = h->max_probe;
+        M_bucket_choices.assign(h->choices, h->choices + h->num_choices);
 
-        return emplace(k, Value()).first->second;
-    }
+        const bool clean    = h->clean;
+        const auto elements = h->elements;
+        if (total != M_buckets + slots)
+        {
+            const auto resized = M_alloc.reallocate(base, total, M_buckets + slots);
+            if (!allocated(resized))
+            {
+                std::allocator_traits<allocator>::deallocate(M_alloc, base, total);
+                throw std::runtime_error("could not map the file");
+            }
+
+            base = resized;
+        }
+        M_file = base + slots;
+        M_alloc.advise(base, M_buckets + slots, M_pattern);
+
+        if (clean)
+        {
+            M_elem = elements;
+        }
+        else
+        {
+            const access temp(M_file, M_buckets);
+            for (size_type index = 0; index != M_buckets; ++index)
+            {
+                M_elem += !temp.is_free(index);
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Find using the control bytes.
+     *
+     *        A key is always between its modded hash and the
+     *        next free bucket. Look at a group of control bytes
+     *        at a time from the modded hash, only reading buckets
+     *        whose control byte matches, until a group has a free
+     *        bucket.
+     *
+     * @param k key to find
+     * @param hashed hash of k as given by @ref hash_key
+     * @return size_type index of k, or number of buckets if
+     *                   not found
+     */
+    template<typename K>
+    size_type
+    control_find(const K& k, size_type hashed) const
+    {
+        constexpr auto width = control_group::width;
+
+        const access temp(M_file, M_buckets);
+        const auto   h    = control_hash(hashed);
+        const auto   ctrl = M_ctrl.data();
+
+        size_type pos = reduce()(hashed, M_buckets);
+        for (size_type seen = 0; seen < M_buckets; seen += width)
+        {
+            const control_group group(ctrl + pos);
+            const std::uint32_t empty = group.match_empty();
+
+            /*  Only look before the first free bucket and
+                only at buckets not looked at yet.
+            */
+            std::uint32_t match = group.match(h);
+            if (empty)
+            {
+                match &= (empty & (~empty + 1)) - 1;
+            }
+            if (M_buckets - seen < width)
+            {
+                match &= (std::uint32_t(1) << (M_buckets - seen)) - 1;
+            }
+
+            for (; match; match &= match - 1)
+            {
+                auto index = pos + lowest_bit(match);
+                if (index >= M_buckets)
+                {
+                    index %= M_buckets;
+                }
+
+                if (temp.matches(index, hashed) && temp.key(index) == k)
+                {
+                    return index;
+                }
+            }
+
+            if (empty)
+            {
+                break;
+            }
+
+            pos += width;
+            if (pos >= M_buckets)
+            {
+                pos %= M_buckets;
+            }
+        }
+
+        return M_buckets;
+    }
+
+    /**
+     * @return size_type index of k, or number of buckets if
+     *                   not found
+     */
+    template<typename K>
+    size_type
+    find_index(const K& k) const
+    {
+        return find_index(k, hash_key(k));
+    }
+
+    /**
+     * @param hashed hash of k as given by @ref hash_key
+     */
+    template<typename K>
+    size_type
+    find_index(const K& k, size_type hashed) const
+    {
+        if (Control)
+        {
+            return control_find(k, hashed);
+        }
+
+        access temp(M_file, M_buckets);
+        const auto res = open_address_find<
+            access,
+            K, size_type,
+            is_free, hash_comp, key_comp<K>,
+            hash_eq>
+        (temp, k, reduce()(hashed, M_buckets), M_buckets);
+
+        return res.second ? res.first : M_buckets;
+    }
+
+    /**
+     * @brief Find n keys a chunk at a time. Every key of a chunk
+     *        is hashed and the cache line of its modded hash
+     *        prefetched before any is searched for, so the cache
+     *        misses of a chunk overlap.
+     *
+     * @param out called with (i, index of keys[i] or number of
+     *            buckets if not found)
+     */
+    template<typename Out>
+    void
+    find_batch_index(const key_type* keys, size_type n, Out out) const
+    {
+        constexpr size_type chunk = 16;
+
+        size_type hashes[chunk];
+        for (size_type start = 0; start < n; start += chunk)
+        {
+            const auto end = std::min(n, start + chunk);
+
+            for (size_type i = start; i != end; ++i)
+            {
+                const auto hashed = hash_key(keys[i]);
+                const auto home   = reduce()(hashed, M_buckets);
+
+                __builtin_prefetch(M_file + home);
+                if (Control)
+                {
+                    __builtin_prefetch(M_ctrl.data() + home);
+                }
+
+                hashes[i - start] = hashed;
+            }
+
+            for (size_type i = start; i != end; ++i)
+            {
+                out(i, find_index(keys[i], hashes[i - start]));
+            }
+        }
+    }
+
+    /**
+     * @brief Hash of a key as stored in the container.
+     */
+    template<typename K>
+    size_type
+    hash_key(const K& k) const
+    {
+        return key_hasher()(k);
+    }
+
+    /**
+     * @brief Modded hash of the element at ptr for a number of
+     *        buckets other than the current.
+     */
+    static size_type
+    home_in(const element* ptr, size_type buckets)
+    {
+        return reduce()(Layout::hash(*ptr, key_hasher()), buckets);
+    }
+
+    /**
+     * @brief Store where each element is relative to its modded
+     *        hash, after the number of buckets changed. Only needed
+     *        by positional layouts.
+     *
+     * @return false if an element is further from its modded
+     *         hash than the layout can store
+     */
+    bool
+    set_homes()
+    {
+        bool fits = true;
+
+        access temp(M_file, M_buckets);
+        for (size_type index = 0; index != M_buckets; ++index)
+        {
+            if (!temp.is_free(index))
+            {
+                const auto home = home_in(M_file + index, M_buckets);
+                if (displacement(index, home, M_buckets) > Layout::max_displacement)
+                {
+                    fits = false;
+                }
+
+                Layout::set_home(temp.block(index), index, home, M_buckets);
+            }
+        }
+
+        return fits;
+    }
+
+    /*  The one pass and copying rehashes, and bulk_load, move
+        elements as bytes. They are only taken when that is the
+        same as moving the key and value, otherwise elements are
+        moved by elem_move or emplaced.
+    */
+    static constexpr bool relocatable = std::is_trivially_copyable<Key>::value &&
+                                        std::is_trivially_copyable<Value>::value;
+
+    /**
+     * @brief Rehash to new_buckets when @ref one_pass_rehash says
+     *        the order of the buckets is kept. The buckets are
+     *        read once from the start. An element goes to
+     *
+     *            max(its new bucket, one past the last element
+     *                placed in the same part)
+     *
+     *        where a part is the range of new buckets a multiple
+     *        of the old number from the start, so that growing
+     *        writes each part in order beside the old buckets and
+     *        shrinking writes at or before the bucket being read.
+     *        Neither overwrites an element not read yet, so no
+     *        index of the new places is needed. Squeezed elements
+     *        from the same old bucket can come out of order, they
+     *        are swapped back among the last placed and the run
+     *        after them settled, see @ref settle.
+     *
+     *        Elements wrapped around the end of the old buckets,
+     *        or which would wrap around the end of their part, are
+     *        kept aside and inserted once the rest is in place, at
+     *        most a cluster of them.
+     *
+     * @return false if the buckets could not grow, nothing moved
+     */
+    bool
+    rehash_one_pass(size_type new_buckets)
+    {
+        using storage = typename std::aligned_storage<sizeof(element), alignof(element)>::type;
+
+        const auto old_buckets = M_buckets;
+        if (new_buckets > old_buckets && !reserve_buckets(new_buckets, true, false, true))
+        {
+            return false;
+        }
+
+        std::vector<storage>   aside;
+        std::vector<size_type> next(std::max(new_buckets / old_buckets, size_type(1)));
+        for (size_type part = 0; part != next.size(); ++part)
+        {
+            next[part] = part * old_buckets;
+        }
+
+        const bool squeeze = new_buckets < old_buckets;
+        access temp(M_file);
+        for (size_type index = 0; index != old_buckets; ++index)
+        {
+            if (temp.is_free(index))
+            {
+                continue;
+            }
+
+            const auto hashed = temp.hash(index);
+            const auto home   = reduce()(hashed, new_buckets);
+            const auto part   = home / old_buckets;
+            const auto limit  = std::min((part + 1) * old_buckets, new_buckets);
+            auto       to     = std::max(home, next[part]);
+
+            if (reduce()(hashed, old_buckets) > index || to >= limit)
+            {
+                aside.emplace_back();
+                std::memcpy(static_cast<void*>(&aside.back()), M_file + index, sizeof(element));
+                temp.set_free(index);
+                continue;
+            }
+
+            next[part] = to + 1;
+            if (to != index)
+            {
+                std::memcpy(static_cast<void*>(M_file + to), M_file + index, sizeof(element));
+                temp.set_free(index);
+            }
+
+            for (; squeeze && to != part * old_buckets && !temp.is_free(to - 1); --to)
+            {
+                const auto before = home_in(M_file + to - 1, new_buckets);
+                if (before <= home)
+                {
+                    break;
+                }
+
+                storage kept;
+                std::memcpy(static_cast<void*>(&kept), M_file + to, sizeof(element));
+                std::memcpy(static_cast<void*>(M_file + to), M_file + to - 1, sizeof(element));
+                std::memcpy(static_cast<void*>(M_file + to - 1), &kept, sizeof(element));
+                Layout::set_home(temp.block(to), to, before, new_buckets);
+            }
+
+            Layout::set_home(temp.block(to), to, home, new_buckets);
+            if (to + 1 != next[part])
+            {
+                next[part] = settle(to, next[part], part * old_buckets, new_buckets);
+            }
+        }
+
+        if (squeeze)
+        {
+            reserve_buckets(new_buckets, true, false, false);
+        }
+
+        for (const auto& kept : aside)
+        {
+            put_back(M_file, M_buckets, reinterpret_cast<const element*>(&kept));
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Move the sorted run of elements from first up to last
+     *        back to where linear probing puts them, once an element
+     *        with an earlier bucket was swapped in at first. None
+     *        moves past start.
+     *
+     * @return one past the last element of the run
+     */
+    size_type
+    settle(size_type first, size_type last, size_type start, size_type buckets)
+    {
+        access temp(M_file);
+
+        auto at = first;
+        for (const auto home = home_in(M_file + first, buckets);
+             at > home && at != start && temp.is_free(at - 1);
+             --at)
+        {
+        }
+
+        for (auto index = first; index != last; ++index)
+        {
+            const auto home = home_in(M_file + index, buckets);
+            const auto to   = std::max(home, at);
+            if (to != index)
+            {
+                std::memcpy(static_cast<void*>(M_file + to), M_file + index, sizeof(element));
+                temp.set_free(index);
+                Layout::set_home(temp.block(to), to, home, buckets);
+            }
+
+            at = to + 1;
+        }
+
+        return at;
+    }
+
+    /**
+     * @brief Insert the element kept aside at e by @ref
+     *        rehash_one_pass, its key is not in the buckets. These
+     *        wrap around the end, so an element goes before the
+     *        first one nearer its own bucket rather than by
+     *        comparing buckets. Control bytes and the bitmap are
+     *        left to be rebuilt.
+     */
+    void
+    put_back(element* file, size_type buckets, const element* e)
+    {
+        const auto home = home_in(e, buckets);
+
+        access temp(file, buckets);
+        auto index = home;
+        while (!temp.is_free(index) &&
+               displacement(index, temp.home(index), buckets) >= displacement(index, home, buckets))
+        {
+            increment_wrap(index, buckets);
+        }
+
+        const auto free = open_address_next_free<
+            access, size_type, is_free>
+        (temp, index, buckets);
+
+        open_address_shift<
+            access, size_type, elem_move>
+        (temp, index, free, buckets);
+
+        std::memcpy(static_cast<void*>(file + index), e, sizeof(element));
+        Layout::set_home(temp.block(index), index, home, buckets);
+    }
+
+    /**
+     * @brief Like @ref put_back, but never touches a bucket at or
+     *        past end nor wraps around, so threads can fill ranges
+     *        of the buckets side by side.
+     *
+     * @return false if e would have to go or push an element to
+     *         end or past it, nothing changed
+     */
+    bool
+    put_back_before(element* file, size_type buckets, const element* e, size_type end)
+    {
+        const auto home = home_in(e, buckets);
+
+        access temp(file, buckets);
+        auto index = home;
+        while (index != end &&
+               !temp.is_free(index) &&
+               index - temp.home(index) >= index - home)
+        {
+            ++index;
+        }
+
+        auto free = index;
+        while (free != end && !temp.is_free(free))
+        {
+            ++free;
+        }
+
+        if (free == end)
+        {
+            return false;
+        }
+
+        open_address_shift<
+            access, size_type, elem_move>
+        (temp, index, free, buckets);
+
+        std::memcpy(static_cast<void*>(file + index), e, sizeof(element));
+        Layout::set_home(temp.block(index), index, home, buckets);
+
+        return true;
+    }
+
+    /**
+     * @brief Copy every element into new_buckets at file on
+     *        threads. First each thread sorts a share of the old
+     *        buckets by the share of the new buckets their
+     *        elements go to, then each thread inserts the elements
+     *        of its share of the new buckets, oldest bucket first.
+     *        A cluster running over the end of a share is handed
+     *        over, its elements left are inserted once the
+     *        threads are done.
+     */
+    void
+    copy_parallel(element* file, size_type new_buckets, size_type threads)
+    {
+        using indices = std::vector<size_type>;
+
+        threads = std::min(threads, new_buckets);
+        const auto width = (new_buckets + threads - 1) / threads;
+
+        std::vector<std::vector<indices>> found(threads, std::vector<indices>(threads));
+        in_parallel(threads, [&](size_type part)
+        {
+            const access temp(M_file);
+            for (auto index = M_buckets * part / threads;
+                 index != M_buckets * (part + 1) / threads;
+                 ++index)
+            {
+                if (!temp.is_free(index))
+                {
+                    found[part][home_in(M_file + index, new_buckets) / width].push_back(index);
+                }
+            }
+        });
+
+        std::vector<indices> handed(threads);
+        in_parallel(threads, [&](size_type part)
+        {
+            const auto end = std::min((part + 1) * width, new_buckets);
+            for (const auto& from : found)
+            {
+                for (const auto index : from[part])
+                {
+                    if (!put_back_before(file, new_buckets, M_file + index, end))
+                    {
+                        handed[part].push_back(index);
+                    }
+                }
+            }
+        });
+
+        for (const auto& from : handed)
+        {
+            for (const auto index : from)
+            {
+                put_back(file, new_buckets, M_file + index);
+            }
+        }
+    }
+
+    /**
+     * @brief Rehash by copying every element into new_buckets in
+     *        a file of its own, see out_of_place_rehash. The old
+     *        buckets are only read, in order. Once the copy is
+     *        synced it is renamed over the file.
+     *
+     * @return false if the new buckets could not be allocated,
+     *         nothing changed
+     */
+    bool
+    rehash_copy(size_type new_buckets, size_type threads)
+    {
+        allocator next(M_alloc);
+        next.use_sibling(".resize");
+
+        const auto slots = header_slots();
+        const auto base  = next.allocate(new_buckets + slots);
+        if (!allocated(base))
+        {
+            return false;
+        }
+
+        const auto file = base + slots;
+        next.advise(base, new_buckets + slots, access_pattern::sequential);
+
+        /*  The file may be left over from a crash.
+        */
+        if (Layout::zero_is_free)
+        {
+            next.clear(file, new_buckets);
+        }
+        else
+        {
+            for (size_type index = 0; index != new_buckets; ++index)
+            {
+                access(file).set_free(index);
+            }
+        }
+
+        if (threads > 1)
+        {
+            copy_parallel(file, new_buckets, threads);
+        }
+        else
+        {
+            const access temp(M_file);
+            for (size_type index = 0; index != M_buckets; ++index)
+            {
+                if (!temp.is_free(index))
+                {
+                    put_back(file, new_buckets, M_file + index);
+                }
+            }
+        }
+
+        const auto lock = flush_lock();
+        allocator old(M_alloc);
+        const auto old_file    = M_file;
+        const auto old_buckets = M_buckets;
+
+        M_alloc   = next;
+        M_file    = file;
+        M_buckets = new_buckets;
+        store_header(false);
+
+        /*  Nothing may be renamed over the file before it is on
+            disk, or a crash could leave neither.
+        */
+        sync_range(base, new_buckets + slots);
+
+        std::allocator_traits<allocator>::deallocate(old, old_file - slots, old_buckets + slots);
+        M_alloc.replace(old);
+
+        return true;
+    }
+
+    /**
+     * @brief Fix what depends on the number of buckets once the
+     *        elements are in place, and grow again if a positional
+     *        layout cannot store where an element ended up.
+     */
+    void
+    end_rehash(access_pattern pattern)
+    {
+        const bool fits = !Layout::positional || set_homes();
+
+        rebuild_meta();
+        advise(pattern);
+
+        if (!fits)
+        {
+            grow();
+        }
+    }
+
+    /**
+     * @brief Whether p is memory, mmap_allocator gives MAP_FAILED
+     *        when it cannot map, with errno saying why.
+     */
+    static bool
+    allocated(const element* p)
+    {
+        return p != reinterpret_cast<const element*>(MAP_FAILED);
+    }
+
+    /**
+     * @brief Reserves elements according to @ref next_size
+     * 
+     * @param buckets number of requested buckets
+     * @param mlf max load factor
+     * @param realloc true to reallocate existing memory, false to
+     *                allocate new memory
+     * @return true reserved more space
+     * @return false failed to reserve space, the container is
+     *               unchanged. Failing to allocate new memory
+     *               throws std::runtime_error, there is nothing
+     *               to keep
+     */
+    bool
+    reserve_choice(size_type buckets,
+                   float mlf,
+                   bool realloc,
+                   bool preserve,
+                   bool larger)
+    {
+        return reserve_buckets(next_size(buckets, mlf, larger), realloc, preserve, larger);
+    }
+
+    /**
+     * @brief @ref reserve_choice for new_buckets already picked
+     *        by @ref next_size, picking again could give fewer
+     *        buckets than the elements need.
+     */
+    bool
+    reserve_buckets(size_type new_buckets,
+                    bool realloc,
+                    bool preserve,
+                    bool larger)
+    {
+        if (new_buckets != max_size() + 1)
+        {
+            const auto lock  = flush_lock();
+            const auto slots = header_slots();
+            const auto base = realloc ? M_alloc.reallocate(M_file - slots, M_buckets + slots, new_buckets + slots)
+                                      : M_alloc.allocate(new_buckets + slots);
+            if (!allocated(base))
+            {
+                /*  Out of disk or address space, the old memory
+                    is still there.
+                */
+                if (!realloc)
+                {
+                    throw std::runtime_error("could not allocate the buckets");
+                }
+
+                return false;
+            }
+
+            M_file = base + slots;
+            M_alloc.advise(M_file - slots, new_buckets + slots, M_pattern);
+
+            if (larger)
+            {
+                if (preserve)
+                {
+                    for (; M_buckets != new_buckets; ++M_buckets)
+                    {
+                        if (!access(M_file).is_free(M_buckets))
+                        {
+                            ++M_elem;
+                        }
+                    }
+                }
+                else
+                {
+                    /*  A file grows with zero bytes, with a layout
+                        where those are free the new pages are not
+                        touched.
+                    */
+                    if (!(realloc && Layout::zero_is_free && is_file_backed<allocator>::value))
+                    {
+                        free_buckets(M_buckets, new_buckets);
+                    }
+
+                    M_buckets = new_buckets;
+                }
+            }
+            else
+            {
+                M_buckets = new_buckets;
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Set buckets from up to to free. When a zero bucket is
+     *        free the allocator clears them, which for a file does
+     *        not write whole pages. Control bytes are not changed.
+     */
+    void
+    free_buckets(size_type from, size_type to)
+    {
+        if (Layout::zero_is_free)
+        {
+            M_alloc.clear(M_file + from, to - from);
+        }
+        else
+        {
+            for (; from != to; ++from)
+            {
+                access(M_file).set_free(from);
+            }
+        }
+    }
+
+    /**
+     * @brief The lock of the flusher when there is one, to be held
+     *        while changing M_file or M_buckets.
+     */
+    periodic_flusher::lock_type
+    flush_lock()
+    {
+        return M_flusher ? periodic_flusher::lock_type(M_flusher->mutex()) : periodic_flusher::lock_type();
+    }
+
+    /**
+     * @brief Write n buckets from first to the file and wait for
+     *        it, counted in M_stats.
+     */
+    void
+    sync_range(element* first, size_type n)
+    {
+        const auto bytes = M_alloc.flush(first, n, true);
+        if (bytes)
+        {
+            ++M_stats.flushes;
+            M_stats.bytes += bytes;
+        }
+    }
+
+    /**
+     * @brief Sync the whole file a chunk at a time, unlocking
+     *        between chunks so growing is not held up for long.
+     *        Runs on the thread of the flusher.
+     */
+    void
+    sync_chunks(periodic_flusher::lock_type& lock)
+    {
+        const size_type chunk = std::max<size_type>(flush_chunk_bytes / sizeof(element), 1);
+        for (size_type from = 0; M_file && from < M_buckets + header_slots(); from += chunk)
+        {
+            const auto total = M_buckets + header_slots();
+            sync_range(M_file - header_slots() + from, std::min(chunk, total - from));
+
+            lock.unlock();
+            lock.lock();
+        }
+    }
+
+    void
+    start_flusher(std::chrono::milliseconds period)
+    {
+        M_flusher.reset(new periodic_flusher(
+            period,
+            [this](periodic_flusher::lock_type& lock)
+            {
+                sync_chunks(lock);
+            }
+        ));
+    }
+
+    static std::string
+    wal_name(const std::string& name)
+    {
+        return name + ".wal";
+    }
+
+    static std::string
+    checkpoint_name(const std::string& name)
+    {
+        return name + ".ckpt";
+    }
+
+    /**
+     * @brief Put back the checkpoint of a file whose log was left
+     *        behind by a container not closed, or remove the file
+     *        so the log is replayed from empty when there is no
+     *        checkpoint. A file closed cleanly after the log was
+     *        left is kept. Throws std::runtime_error if the
+     *        checkpoint cannot be copied.
+     *
+     * @return true if the log has to be replayed
+     */
+    static bool
+    restore_checkpoint(const std::string& name)
+    {
+        if (::access(wal_name(name).c_str(), F_OK))
+        {
+            return false;
+        }
+
+        file_header h;
+        const int  fd    = ::open(name.c_str(), O_RDONLY);
+        const bool clean = fd != -1 &&
+                           ::pread(fd, &h, sizeof(h), 0) == sizeof(h) &&
+                           h.magic == file_header_magic &&
+                           h.clean;
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+
+        /*  Nothing in the file is trusted, the log is never
+            replayed onto it.
+        */
+        if (!clean && !copy_file(checkpoint_name(name), name))
+        {
+            if (!::access(checkpoint_name(name).c_str(), F_OK))
+            {
+                throw std::runtime_error("could not restore checkpoint");
+            }
+
+            ::remove(name.c_str());
+        }
+
+        return !clean;
+    }
+
+    /**
+     * @brief Replay what was left in the log and checkpoint before
+     *        the log is opened for new operations. A file closed
+     *        cleanly with its checkpoint and log keeps them, new
+     *        operations go after the old, so reopening does not
+     *        copy the file.
+     */
+    void
+    start_wal(std::string name, bool replay, bool opened, size_type group)
+    {
+        if (replay)
+        {
+            write_ahead_log left(wal_name(name));
+            left.replay([this](wal_op op, const char* payload, std::size_t size)
+            {
+                wal_apply(op, payload, size);
+            });
+        }
+
+        const bool keep = !replay && opened &&
+                          !::access(wal_name(name).c_str(), F_OK) &&
+                          !::access(checkpoint_name(name).c_str(), F_OK);
+
+        M_wal_base  = std::move(name);
+        M_wal_group = std::max<size_type>(group, 1);
+        if (!keep && !write_checkpoint())
+        {
+            throw std::runtime_error("could not write checkpoint");
+        }
+
+        M_wal.reset(new write_ahead_log(wal_name(M_wal_base)));
+        if (!M_wal->is_open() || (!keep && !M_wal->truncate()))
+        {
+            M_wal.reset();
+            throw std::runtime_error("could not open log");
+        }
+    }
+
+    /**
+     * @brief Copy the synced file as the checkpoint. The copy has
+     *        a clean header so opening it does not count.
+     */
+    bool
+    write_checkpoint()
+    {
+        finish_resize();
+        if (M_wal)
+        {
+            wal_flush_assigned();
+        }
+        store_header(true);
+        sync();
+        const bool copied = copy_file(M_wal_base, checkpoint_name(M_wal_base));
+        store_dirty_header();
+
+        return copied;
+    }
+
+    /**
+     * @brief Mark the header not clean and wait for it to reach
+     *        the file, before any bucket changes. Otherwise a
+     *        crash could leave changed buckets behind a header
+     *        still clean from the last close or checkpoint, and
+     *        the log would not be replayed.
+     */
+    void
+    store_dirty_header()
+    {
+        store_header(false);
+        if (header_slots() && M_file)
+        {
+            sync_range(M_file - header_slots(), header_slots());
+        }
+    }
+
+    /**
+     * @brief Do an operation read from the log.
+     */
+    void
+    wal_apply(wal_op op, const char* payload, std::size_t size)
+    {
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type     key;
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type value;
+        const Key&   k = reinterpret_cast<const Key&>(key);
+        const Value& v = reinterpret_cast<const Value&>(value);
+
+        const bool has_value = op == wal_op::insert || op == wal_op::assign;
+        if (op != wal_op::clear && size != sizeof(Key) + has_value * sizeof(Value))
+        {
+            return;
+        }
+
+        if (op != wal_op::clear)
+        {
+            std::memcpy(&key, payload, sizeof(Key));
+        }
+        if (has_value)
+        {
+            std::memcpy(&value, payload + sizeof(Key), sizeof(Value));
+        }
+
+        switch (op)
+        {
+        case wal_op::insert:
+            emplace_key(k, v);
+            break;
+        case wal_op::assign:
+            insert_or_assign(k, v);
+            break;
+        case wal_op::erase:
+            erase_key(k);
+            break;
+        case wal_op::clear:
+            clear();
+            break;
+        }
+    }
+
+    /**
+     * @brief Log op on the element at index.
+     */
+    void
+    wal_log(wal_op op, size_type index)
+    {
+        wal_flush_assigned();
+
+        const auto& elem = access(M_file).value_type(index);
+        if (op == wal_op::erase)
+        {
+            M_wal->append(op, std::addressof(elem.first), sizeof(Key), nullptr, 0);
+        }
+        else
+        {
+            M_wal->append(op, std::addressof(elem.first), sizeof(Key), std::addressof(elem.second), sizeof(Value));
+        }
+
+        wal_group();
+    }
+
+    /**
+     * @brief Commit once M_wal_group operations are logged.
+     */
+    void
+    wal_group()
+    {
+        if (++M_wal_pending >= M_wal_group)
+        {
+            M_wal_pending = 0;
+            if (!M_wal->commit())
+            {
+                throw std::runtime_error("could not commit log");
+            }
+        }
+    }
+
+    /**
+     * @brief Log the value of the key last given out by
+     *        operator[], it may have been written through the
+     *        reference since. The key is kept rather than its
+     *        index since inserts shift elements.
+     */
+    void
+    wal_flush_assigned()
+    {
+        if (!M_wal_assigned)
+        {
+            return;
+        }
+
+        M_wal_assigned = false;
+        const Key& k    = reinterpret_cast<const Key&>(M_wal_key);
+        const auto iter = find_iter(k, hash_key(k));
+        if (iter != end())
+        {
+            M_wal->append(wal_op::assign, std::addressof(iter->first), sizeof(Key), std::addressof(iter->second), sizeof(Value));
+        }
+    }
+
+    /**
+     * @brief operator[] on a table with a log, the value is
+     *        logged before the next operation is.
+     */
+    template<typename K>
+    Value&
+    wal_subscript(K&& k)
+    {
+        wal_flush_assigned();
+
+        const auto res = try_emplace(std::forward<K>(k));
+        std::memcpy(&M_wal_key, std::addressof(res.first->first), sizeof(Key));
+        M_wal_assigned = true;
+
+        return res.first->second;
+    }
+
+    /**
+     * @brief Number of elements the current buckets can hold
+     *        without going over the max load factor.
+     */
+    size_type
+    max_elements() const
+    {
+        return static_cast<size_type>(M_buckets * static_cast<double>(M_load));
+    }
+
+    /**
+     * @brief Rehash to strictly more buckets than there are now.
+     */
+    void
+    grow()
+    {
+        M_probe_grow = false;
+        if (M_step && !Layout::positional && start_resize(max_elements() + 1))
+        {
+            return;
+        }
+
+        rehash(max_elements() + 1);
+    }
+
+    /**
+     * @brief Growing for a long probe only once the container is
+     *        a quarter of the way to the max load factor. Below
+     *        that probes are long because keys share a modded
+     *        hash, which more buckets do not fix.
+     */
+    bool
+    probe_grow_allowed() const
+    {
+        return M_elem + 1 > max_elements() / 4;
+    }
+
+    /**
+     * @brief Start moving to at least buckets, see
+     *        incremental_rehash. The new buckets are allocated
+     *        next to the old, which are emptied a step at a time
+     *        by @ref resize_step.
+     *
+     * @return false if there are no more buckets to move to or
+     *         they could not be allocated
+     */
+    bool
+    start_resize(size_type buckets)
+    {
+        finish_resize();
+
+        const auto new_buckets = next_size(buckets, M_load, true);
+        if (new_buckets > max_size() || new_buckets <= M_buckets)
+        {
+            return false;
+        }
+
+        /*  A file of its own until the move is done, then it
+            replaces the file.
+        */
+        allocator next(M_alloc);
+        next.use_sibling(".resize");
+
+        const auto slots = header_slots();
+        const auto base  = next.allocate(new_buckets + slots);
+        if (!allocated(base))
+        {
+            return false;
+        }
+
+        const auto lock = flush_lock();
+        M_old_alloc   = M_alloc;
+        M_alloc       = next;
+        M_old         = M_file;
+        M_old_buckets = M_buckets;
+        M_file        = base + slots;
+        M_buckets     = new_buckets;
+
+        free_buckets(0, M_buckets);
+        M_alloc.advise(base, M_buckets + slots, M_pattern);
+        rebuild_meta();
+
+        /*  Start at a free bucket, so a cluster wrapping around
+            the end is moved whole by the last step.
+        */
+        const access old(M_old, M_old_buckets);
+        M_old_at = 0;
+        while (M_old_at != M_old_buckets && !old.is_free(M_old_at))
+        {
+            ++M_old_at;
+        }
+        M_old_at  *= M_old_at != M_old_buckets;
+        M_old_left = M_old_buckets;
+
+        store_header(false);
+
+        return true;
+    }
+
+    /**
+     * @brief Move the element at old_index of the old buckets
+     *        into the buckets. An insert which knows the key is
+     *        not there.
+     */
+    void
+    migrate(size_type old_index)
+    {
+        access old(M_old, M_old_buckets);
+        auto&      kv     = old.value_type(old_index);
+        const auto hashed = old.hash(old_index);
+        const auto home   = reduce()(hashed, M_buckets);
+
+        auto temp = make_access();
+        const auto index = open_address_find<
+            access,
+            Key, size_type,
+            is_free, hash_comp, key_comp<Key>,
+            hash_eq>
+        (temp, kv.first, home, M_buckets).first;
+
+        const auto free = open_address_next_free<
+            access, size_type, is_free>
+        (temp, index, M_buckets);
+
+        open_address_shift<
+            access, size_type, elem_move>
+        (temp, index, free, M_buckets);
+
+        Layout::construct
+        (
+            M_file + index,
+            hashed,
+            displacement(index, home, M_buckets),
+            std::piecewise_construct,
+            std::forward_as_tuple(kv.first),
+            std::forward_as_tuple(std::move(kv.second))
+        );
+        temp.set_ctrl(index, control_hash(hashed));
+
+        if (M_bits_built)
+        {
+            bitmap_set(M_bits.data(), free);
+            M_first = std::min(M_first, free);
+        }
+
+        if (M_probe && displacement(free, home, M_buckets) > M_probe)
+        {
+            M_probe_grow = true;
+        }
+
+        using alloc = std::allocator<value_type>;
+        alloc a;
+        std::allocator_traits<alloc>::destroy(a, std::addressof(kv));
+        old.set_free(old_index);
+    }
+
+    /**
+     * @brief Move the cluster of old buckets holding index. Taking
+     *        out a whole cluster leaves every other key of the old
+     *        buckets where a find would look.
+     */
+    void
+    migrate_cluster(size_type index)
+    {
+        const access old(M_old, M_old_buckets);
+        for (size_type seen = 0; seen != M_old_buckets; ++seen)
+        {
+            auto prev = index;
+            decrement_wrap(prev, M_old_buckets);
+            if (old.is_free(prev))
+            {
+                break;
+            }
+
+            index = prev;
+        }
+
+        for (; !old.is_free(index); increment_wrap(index, M_old_buckets))
+        {
+            migrate(index);
+        }
+    }
+
+    /**
+     * @brief Move at least M_step old buckets, carrying on to the
+     *        end of a cluster, and finish once there are none.
+     */
+    void
+    resize_step()
+    {
+        if (!M_old)
+        {
+            return;
+        }
+
+        const access old(M_old, M_old_buckets);
+        for (size_type moved = 0;
+             M_old_left && (moved < M_step || !old.is_free(M_old_at));
+             ++moved)
+        {
+            if (!old.is_free(M_old_at))
+            {
+                migrate(M_old_at);
+            }
+
+            increment_wrap(M_old_at, M_old_buckets);
+            --M_old_left;
+        }
+
+        if (!M_old_left)
+        {
+            end_resize();
+        }
+    }
+
+    /**
+     * @brief Before changing the buckets for k while rehashing,
+     *        take a step and move the cluster of k, so that k is
+     *        only in the buckets.
+     */
+    template<typename K>
+    void
+    resize_for(const K& k, size_type hashed)
+    {
+        resize_step();
+        if (M_old)
+        {
+            const auto index = find_old(k, hashed);
+            if (index != M_old_buckets)
+            {
+                migrate_cluster(index);
+            }
+        }
+    }
+
+    /**
+     * @brief Move every old bucket left, does nothing if not
+     *        rehashing.
+     */
+    void
+    finish_resize()
+    {
+        if (!M_old)
+        {
+            return;
+        }
+
+        const access old(M_old, M_old_buckets);
+        for (; M_old_left; --M_old_left)
+        {
+            if (!old.is_free(M_old_at))
+            {
+                migrate(M_old_at);
+            }
+
+            increment_wrap(M_old_at, M_old_buckets);
+        }
+
+        end_resize();
+    }
+
+    /**
+     * @brief Give the old buckets back, the file of the buckets
+     *        takes the name of the old file.
+     */
+    void
+    end_resize()
+    {
+        const auto lock  = flush_lock();
+        const auto slots = header_slots();
+        std::allocator_traits<allocator>::deallocate
+        (
+            M_old_alloc,
+            M_old - slots,
+            M_old_buckets + slots
+        );
+
+        M_alloc.replace(M_old_alloc);
+        M_old_alloc   = allocator();
+        M_old         = nullptr;
+        M_old_buckets = 0;
+
+        store_header(false);
+    }
+
+    /**
+     * @brief Index of k in the old buckets, their number if it is
+     *        not there.
+     */
+    template<typename K>
+    size_type
+    find_old(const K& k, size_type hashed) const
+    {
+        const access temp(M_old, M_old_buckets);
+        const auto res = open_address_find<
+            access,
+            K, size_type,
+            is_free, hash_comp, key_comp<K>,
+            hash_eq>
+        (temp, k, reduce()(hashed, M_old_buckets), M_old_buckets);
+
+        return res.second ? res.first : M_old_buckets;
+    }
+
+    /**
+     * @brief Iterator to k, looking in the old buckets too while
+     *        rehashing.
+     */
+    template<typename K>
+    iterator
+    find_iter(const K& k, size_type hashed)
+    {
+        const auto index = find_index(k, hashed);
+        if (index == M_buckets && M_old)
+        {
+            const auto old = find_old(k, hashed);
+            if (old != M_old_buckets)
+            {
+                return make_iter(M_old + old);
+            }
+        }
+
+        return make_iter(index);
+    }
+
+    template<typename K>
+    const_iterator
+    find_iter(const K& k, size_type hashed) const
+    {
+        const auto index = find_index(k, hashed);
+        if (index == M_buckets && M_old)
+        {
+            const auto old = find_old(k, hashed);
+            if (old != M_old_buckets)
+            {
+                return make_iter(M_old + old);
+            }
+        }
+
+        return make_iter(index);
+    }
+
+    /*  Iterators only skip with the bitmap once it is built,
+        so that find does not build it. While rehashing they
+        walk the old buckets before the buckets.
+    */
+    iterator
+    make_iter(size_type index)
+    {
+        return make_iter(M_file + index);
+    }
+
+    const_iterator
+    make_iter(size_type index) const
+    {
+        return make_iter(M_file + index);
+    }
+
+    iterator
+    make_iter(element* ptr)
+    {
+        return iterator(ptr, M_file + M_buckets, M_file, M_bits_built ? M_bits.data() : nullptr,
+                        M_old, M_old + M_old_buckets);
+    }
+
+    const_iterator
+    make_iter(element* ptr) const
+    {
+        return const_iterator(ptr, M_file + M_buckets, M_file, M_bits_built ? M_bits.data() : nullptr,
+                              M_old, M_old + M_old_buckets);
+    }
+
+public:
+
+    unordered_map_file() :
+        M_buckets(0), M_elem(0),
+        M_alloc(),
+        M_delete(false),
+        M_load(1),
+        M_probe(0),
+        M_probe_grow(false),
+        M_durability(durability_mode::on_close),
+        M_stats(),
+        M_pattern(access_pattern::normal),
+        M_old(nullptr),
+        M_old_buckets(0),
+        M_old_at(0),
+        M_old_left(0),
+        M_step(0),
+        M_copy_rehash(false),
+        M_wal_group(0),
+        M_wal_pending(0),
+        M_wal_assigned(false)
+    {
+        reserve_choice(0, M_load, false, false, true);
+        rebuild_meta();
+        store_header(false);
+    }
+
+    unordered_map_file(size_type buckets) :
+        M_buckets(0), M_elem(0),
+        M_alloc(),
+        M_delete(false),
+        M_load(1),
+        M_probe(0),
+        M_probe_grow(false),
+        M_durability(durability_mode::on_close),
+        M_stats(),
+        M_pattern(access_pattern::normal),
+        M_old(nullptr),
+        M_old_buckets(0),
+        M_old_at(0),
+        M_old_left(0),
+        M_step(0),
+        M_copy_rehash(false),
+        M_wal_group(0),
+        M_wal_pending(0),
+        M_wal_assigned(false)
+    {
+        reserve_choice(buckets, M_load, false, false, true);
+        rebuild_meta();
+        store_header(false);
+    }
+
+    unordered_map_file(std::string name) :
+        M_buckets(0), M_elem(0),
+        M_alloc(std::move(name)),
+        M_delete(false),
+        M_load(1),
+        M_probe(0),
+        M_probe_grow(false),
+        M_durability(durability_mode::on_close),
+        M_stats(),
+        M_pattern(access_pattern::normal),
+        M_old(nullptr),
+        M_old_buckets(0),
+        M_old_at(0),
+        M_old_left(0),
+        M_step(0),
+        M_copy_rehash(false),
+        M_wal_group(0),
+        M_wal_pending(0),
+        M_wal_assigned(false)
+    {
+        reserve_choice(0, M_load, false, false, true);
+        rebuild_meta();
+        store_header(false);
+    }
+
+    /**
+     * @param preserve true to keep what is in the file. When
+     *                 backed by a file buckets is ignored if the
+     *                 file exists, the header of the file gives
+     *                 it. Throws std::runtime_error if the file
+     *                 was written by a container of other types
+     */
+    unordered_map_file(std::string name, size_type buckets, bool preserve) :
+        M_buckets(0), M_elem(0),
+        M_alloc(std::move(name)),
+        M_delete(false),
+        M_load(1),
+        M_probe(0),
+        M_probe_grow(false),
+        M_durability(durability_mode::on_close),
+        M_stats(),
+        M_pattern(access_pattern::normal),
+        M_old(nullptr),
+        M_old_buckets(0),
+        M_old_at(0),
+        M_old_left(0),
+        M_step(0),
+        M_copy_rehash(false),
+        M_wal_group(0),
+        M_wal_pending(0),
+        M_wal_assigned(false)
+    {
+        const bool file_backed = is_file_backed<allocator>::value;
+        if (!(file_backed && preserve && open_file()))
+        {
+            reserve_choice(buckets, M_load, false, preserve && !file_backed, true);
+        }
+
+        rebuild_meta();
+        store_header(false);
+    }
+
+    /**
+     * @brief Keep a log of the operations next to the file, see
+     *        write_ahead_log.h. With preserve a file not closed
+     *        cleanly goes back to its checkpoint and replays the
+     *        log. Only operations through the container are
+     *        logged, a value written through the reference from
+     *        operator[] is logged before the next operation,
+     *        commit or close, other writes through references to
+     *        values are not. Throws std::runtime_error if the log
+     *        cannot be kept, or from an operation whose commit
+     *        failed, the operation is done but may be lost.
+     */
+    unordered_map_file(std::string name, size_type buckets, bool preserve, write_ahead wal) :
+        M_buckets(0), M_elem(0),
+        M_alloc(name),
+        M_delete(false),
+        M_load(1),
+        M_probe(0),
+        M_probe_grow(false),
+        M_durability(durability_mode::on_close),
+        M_stats(),
+        M_pattern(access_pattern::normal),
+        M_old(nullptr),
+        M_old_buckets(0),
+        M_old_at(0),
+        M_old_left(0),
+        M_step(0),
+        M_copy_rehash(false),
+        M_wal_group(0),
+        M_wal_pending(0),
+        M_wal_assigned(false)
+    {
+        static_assert(is_file_backed<allocator>::value, "a log is kept next to a file");
+        static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                      "logged keys and values are copied as bytes");
+
+        const bool replay = preserve && restore_checkpoint(name);
+        const bool opened = preserve && open_file();
+        if (!opened)
+        {
+            reserve_choice(buckets, M_load, false, false, true);
+        }
+        rebuild_meta();
+        store_dirty_header();
+
+        start_wal(std::move(name), replay, opened, wal.group_ops);
+    }
+
+    unordered_map_file(size_type buckets, std::string name) :
+        M_buckets(0), M_elem(0),
+        M_alloc(std::move(name)),
+        M_delete(false),
+        M_load(1),
+        M_probe(0),
+        M_probe_grow(false),
+        M_durability(durability_mode::on_close),
+        M_stats(),
+        M_pattern(access_pattern::normal),
+        M_old(nullptr),
+        M_old_buckets(0),
+        M_old_at(0),
+        M_old_left(0),
+        M_step(0),
+        M_copy_rehash(false),
+        M_wal_group(0),
+        M_wal_pending(0),
+        M_wal_assigned(false)
+    {
+        reserve_choice(buckets, M_load, false, false, true);
+        rebuild_meta();
+        store_header(false);
+    }
+
+    unordered_map_file(
+        size_type buckets,
+        std::string name,
+        std::initializer_list<size_type> choices = {}
+    ) :
+        M_buckets(0), M_elem(0),
+        M_alloc(std::move(name)),
+        M_delete(false),
+        M_load(1),
+        M_probe(0),
+        M_probe_grow(false),
+        M_durability(durability_mode::on_close),
+        M_stats(),
+        M_pattern(access_pattern::normal),
+        M_old(nullptr),
+        M_old_buckets(0),
+        M_old_at(0),
+        M_old_left(0),
+        M_step(0),
+        M_copy_rehash(false),
+        M_wal_group(0),
+        M_wal_pending(0),
+        M_wal_assigned(false)
+    {
+        if (choices.size())
+        {
+            bucket_choices(choices);
+        }
+
+        reserve_choice(buckets, M_load, false, false, true);
+        rebuild_meta();
+        store_header(false);
+    }
+
+    /**
+     * @brief Build from the pairs in [first,last), see bulk_load.
+     */
+    template<typename ForwardIt,
+             typename = typename std::iterator_traits<ForwardIt>::iterator_category>
+    unordered_map_file(ForwardIt first, ForwardIt last) :
+        unordered_map_file()
+    {
+        bulk_load(first, last);
+    }
+
+    template<typename ForwardIt,
+             typename = typename std::iterator_traits<ForwardIt>::iterator_category>
+    unordered_map_file(std::string name, ForwardIt first, ForwardIt last) :
+        unordered_map_file(std::move(name))
+    {
+        bulk_load(first, last);
+    }
+
+    unordered_map_file(unordered_map_file&& rv) :
+        M_buckets(rv.M_buckets), M_elem(rv.M_elem),
+        M_alloc(rv.M_alloc),
+        M_delete(rv.M_delete),
+        M_load(rv.M_load),
+        M_probe(rv.M_probe),
+        M_probe_grow(rv.M_probe_grow),
+        M_file(rv.M_file),
+        M_ctrl(std::move(rv.M_ctrl)),
+        M_bits(std::move(rv.M_bits)),
+        M_first(rv.M_first),
+        M_bits_built(rv.M_bits_built),
+        M_durability(rv.M_durability),
+        M_stats(rv.M_stats),
+        M_pattern(rv.M_pattern),
+        M_old_alloc(rv.M_old_alloc),
+        M_old(rv.M_old),
+        M_old_buckets(rv.M_old_buckets),
+        M_old_at(rv.M_old_at),
+        M_old_left(rv.M_old_left),
+        M_step(rv.M_step),
+        M_copy_rehash(rv.M_copy_rehash),
+        M_wal(std::move(rv.M_wal)),
+        M_wal_base(std::move(rv.M_wal_base)),
+        M_wal_group(rv.M_wal_group),
+        M_wal_pending(rv.M_wal_pending),
+        M_wal_key(rv.M_wal_key),
+        M_wal_assigned(rv.M_wal_assigned)
+    {
+        /*  The flusher of rv looks at rv, it is stopped before
+            rv changes and a new one started for this.
+        */
+        if (rv.M_flusher)
+        {
+            const auto period = rv.M_flusher->period();
+            rv.M_flusher.reset();
+            start_flusher(period);
+        }
+
+        rv.M_file = nullptr;
+        rv.M_old  = nullptr;
+    }
+
+    ~unordered_map_file()
+    {
+        M_flusher.reset();
+        finish_resize();
+
+        /*  Closed cleanly, the checkpoint and log are kept so
+            reopening does not write a checkpoint. A log which
+            could not be committed is removed with its
+            checkpoint and the next open writes one.
+        */
+        if (M_wal)
+        {
+            wal_flush_assigned();
+            const bool committed = M_wal->commit();
+            M_wal.reset();
+
+            if (!committed || M_delete)
+            {
+                ::remove(wal_name(M_wal_base).c_str());
+                ::remove(checkpoint_name(M_wal_base).c_str());
+            }
+        }
+
+        if (M_file)
+        {
+            /*  The buckets before the header which says they
+                are complete.
+            */
+            const bool sync_close = M_durability == durability_mode::on_close || !M_wal_base.empty();
+            if (sync_close)
+            {
+                sync_range(M_file, M_buckets);
+            }
+
+            store_header(true);
+            if (sync_close)
+            {
+                sync_range(M_file - header_slots(), header_slots());
+            }
+
+            std::allocator_traits<allocator>::deallocate
+            (
+                M_alloc,
+                M_file - header_slots(),
+                M_buckets + header_slots()
+            );
+        }
+
+        if (M_delete)
+        {
+            M_alloc.wipe();
+        }
+    }
+
+    Value& operator[](const Key& k)
+    {
+        if (M_wal)
+        {
+            return wal_subscript(k);
+        }
+
+        return try_emplace(k).first->second;
+    }
 
     Value& operator[](Key&& k)
     {
-        auto iter = find(k);
-        if (iter != end())
+        if (M_wal)
         {
-            return iter->second;
+            return wal_subscript(std::move(k));
         }
 
-        return emplace(k, Value()).first->second;
+        return try_emplace(std::move(k)).first->second;
     }
 
     size_type
@@ -872,31 +2866,36 @@ public:
         return M_elem;
     }
 
+    /**
+     * @brief While rehashing the old buckets are walked before
+     *        the buckets, nothing is moved.
+     */
     const_iterator
     cbegin() const
     {
-        auto iter = make_iter(0);
-        if (access(M_file, M_buckets).is_free(0))
+        if (M_old)
         {
-            return ++iter;
+            auto iter = make_iter(M_old);
+            if (Layout::is_free(*M_old))
+            {
+                ++iter;
+            }
+
+            return iter;
         }
 
-        return iter;
+        return make_iter(first_index());
     }
 
+    /**
+     * @brief Finishes rehashing first, iterators then only walk
+     *        the buckets.
+     */
     iterator
     begin()
     {
-        /*  NOTE: this is not constant time, should be
-        */
-
-        auto iter = make_iter(0);
-        if (access(M_file, M_buckets).is_free(0))
-        {
-            return ++iter;
-        }
-
-        return iter;
+        finish_resize();
+        return make_iter(first_index());
     }
 
     const_iterator
@@ -911,15 +2910,45 @@ public:
         return make_iter(M_buckets);
     }
 
+    /**
+     * @brief Make room for at least the number of elements
+     *        without going over the max load factor.
+     */
     void
     reserve(size_type buckets)
     {
         rehash(buckets);
     }
 
+    /**
+     * @brief Move to the number of buckets @ref next_size picks
+     *        to hold buckets number of elements at the max load
+     *        factor. Never picks fewer than what is needed for
+     *        the current elements.
+     */
     void
     rehash(size_type buckets)
     {
+        rehash(buckets, 1);
+    }
+
+    /**
+     * @brief @ref rehash with the work split over threads. The
+     *        elements are copied into new buckets as with
+     *        out_of_place_rehash, each thread reading a share of
+     *        the old buckets and then filling a share of the new.
+     *        Moves in place on one thread if the copy cannot be
+     *        allocated, or if Key or Value is not trivially
+     *        copyable.
+     *
+     * @param threads number of threads, 1 or less rehashes on
+     *                the calling thread
+     */
+    void
+    rehash(size_type buckets, size_type threads)
+    {
+        finish_resize();
+
         /*  (modded, hash, order of insertion)
             0 (2,22,4)
             1 (1,11,0)
@@ -1130,10 +3159,10 @@ public:
                     return 2;
                 }
 
-                return hash_comp()(
-                    {cont.back().second, cont.back().first},
-                    orig_elem_ptr - cont.back().second, cont[against].second - cont.back().second
-                );
+                const auto modded_curr    = home_in(orig_elem_ptr, cont.back().first);
+                const auto modded_against = home_in(cont[against].second, cont.back().first);
+
+                return (modded_curr >= modded_against) * (1 + (modded_curr > modded_against));
             }
         };
 
@@ -1173,19 +3202,54 @@ public:
             size_type
             operator()(const local_cont& cont, size_type curr, size_type num)
             {
-                const auto orig_elem_ptr = cont[curr].second;
+                const auto buckets   = cont.back().first;
+                const auto from_home = displacement(curr, home_in(cont[curr].second, buckets), buckets);
+                const auto from_num  = displacement(curr, num, buckets);
 
-                return hash_eq()(
-                    {cont.back().second, cont.back().first},
-                    orig_elem_ptr - cont.back().second, num
-                );
+                return (from_home <= from_num) * (1 + (from_home < from_num));
             }
         };
 
-        const auto new_buckets = next_size(buckets, M_load, buckets > M_buckets);
+        buckets = std::max(buckets, M_elem);
+
+        const auto needed = std::ceil(M_elem / static_cast<double>(M_load));
+        const bool larger = std::ceil(buckets / static_cast<double>(M_load)) > M_buckets;
+        auto new_buckets  = next_size(buckets, M_load, larger);
+        if (new_buckets < needed)
+        {
+            new_buckets = next_size(M_elem, M_load, true);
+        }
+
+        if (new_buckets == M_buckets || new_buckets > max_size())
+        {
+            return;
+        }
+
+        M_probe_grow = false;
+
+        /*  Every bucket is read in order, then written about in
+            order.
+        */
+        const auto pattern = M_pattern;
+        advise(access_pattern::sequential);
+
+        if (relocatable && (M_copy_rehash || threads > 1) && rehash_copy(new_buckets, threads))
+        {
+            end_rehash(pattern);
+            return;
+        }
 
-        if (new_buckets == M_buckets)
+        if (relocatable && one_pass_rehash<reduce>::possible(M_buckets, new_buckets))
         {
+            if (rehash_one_pass(new_buckets))
+            {
+                end_rehash(pattern);
+            }
+            else
+            {
+                advise(pattern);
+            }
+
             return;
         }
 
@@ -1212,16 +3276,19 @@ public:
                 Key, size_type,
                 local_is_free, local_hash_comp, local_key_comp, local_elem_transfer,
                 bruh_hash_eq>
-            (vec, temp.key(index), temp.hash(index), new_buckets).first;
+            (vec, temp.key(index), reduce()(temp.hash(index), new_buckets), new_buckets).first;
 
             vec[index].first      = now_taken;
             vec[now_taken].second = M_file + index;
         }
 
+        /*  Could not grow, nothing has moved yet.
+        */
         const size_type loop_to = M_buckets;
-        if (new_buckets > M_buckets)
+        if (new_buckets > M_buckets && !reserve_buckets(new_buckets, true, false, true))
         {
-            reserve_choice(new_buckets, M_load, true, false, true);
+            advise(pattern);
+            return;
         }
 
         /*  NOTE: document
@@ -1251,11 +3318,29 @@ public:
                     going_to = vec[going_to].first;
                 }
 
+                /*  A chain leading back to index is a cycle, the
+                    element at index is overwritten first so it is
+                    kept aside and put in place last.
+                */
+                const bool cycle = stack.back() == index;
+                typename std::aligned_storage<sizeof(element), alignof(element)>::type kept;
+                if (cycle)
+                {
+                    std::memcpy(&kept, M_file + index, sizeof(element));
+                }
+
                 while (stack.size() > 1)
                 {
                     auto end = stack.rbegin();
-                    elem_move()(M_file, *end, *(end + 1));
-                    access(M_file).set_free(*(end + 1), true);
+                    if (cycle && stack.size() == 2)
+                    {
+                        std::memcpy(static_cast<void*>(M_file + *end), &kept, sizeof(element));
+                    }
+                    else
+                    {
+                        elem_move()(M_file, *end, *(end + 1));
+                        access(M_file).set_free(*(end + 1));
+                    }
                     stack.pop_back();
                 }
                 stack.pop_back();
@@ -1264,46 +3349,108 @@ public:
 
         if (new_buckets < M_buckets)
         {
-            reserve_choice(new_buckets, M_load, true, false, false);
+            reserve_buckets(new_buckets, true, false, false);
         }
+
+        end_rehash(pattern);
     }
 
     iterator
     find(const_reference_key k)
     {
-        access temp(M_file, M_buckets);
-        const auto res = open_address_find<
-            access,
-            key_type, size_type,
-            is_free, hash_comp, key_comp<key_type>,
-            hash_eq>
-        (temp, k, Hash()(k), M_buckets);
+        resize_step();
+        return find_iter(k, hash_key(k));
+    }
+
+    const_iterator
+    find(const_reference_key k) const
+    {
+        return find_iter(k, hash_key(k));
+    }
+
+    /**
+     * @brief Find n keys, faster than find in a loop when the
+     *        container is much larger than the cache since the
+     *        cache misses of keys close in the array overlap.
+     *
+     *        Finishes rehashing first, a step for each key would
+     *        move the elements found by the keys before it.
+     *
+     * @param keys keys to find
+     * @param n number of keys
+     * @param out out[i] is set to find(keys[i])
+     */
+    void
+    find_batch(const key_type* keys, size_type n, iterator* out)
+    {
+        finish_resize();
 
-        if (!res.second)
+        find_batch_index(keys, n, [&](size_type i, size_type index)
         {
-            return make_iter(M_buckets);
+            out[i] = make_iter(index);
+        });
+    }
+
+    void
+    find_batch(const key_type* keys, size_type n, const_iterator* out) const
+    {
+        if (M_old)
+        {
+            for (size_type i = 0; i != n; ++i)
+            {
+                out[i] = find(keys[i]);
+            }
+            return;
         }
 
-        return make_iter(res.first);
+        find_batch_index(keys, n, [&](size_type i, size_type index)
+        {
+            out[i] = make_iter(index);
+        });
     }
 
-    const_iterator
-    find(const_reference_key k) const
+    /**
+     * @brief See @ref find_batch
+     *
+     * @param out out[i] is set to contains(keys[i])
+     */
+    void
+    contains_batch(const key_type* keys, size_type n, bool* out) const
     {
-        access temp(M_file, M_buckets);
-        const auto res = open_address_find<
-            access,
-            key_type, size_type,
-            is_free, hash_comp, key_comp<key_type>,
-            hash_eq>
-        (temp, k, Hash()(k), M_buckets);
-
-        if (!res.second)
+        if (M_old)
         {
-            return make_iter(M_buckets);
+            for (size_type i = 0; i != n; ++i)
+            {
+                out[i] = contains(keys[i]);
+            }
+            return;
         }
 
-        return make_iter(res.first);
+        find_batch_index(keys, n, [&](size_type i, size_type index)
+        {
+            out[i] = index != M_buckets;
+        });
+    }
+
+    /**
+     * @brief Find without making a key, only when Hash is
+     *        transparent. Hash()(k) and key == k must work.
+     */
+    template<typename K, typename Transparent = Hash,
+             typename std::enable_if<hash_is_transparent<Transparent>::value, int>::type = 0>
+    iterator
+    find(const K& k)
+    {
+        resize_step();
+        return find_iter(k, hash_key(k));
+    }
+
+    template<typename K, typename Transparent = Hash,
+             typename std::enable_if<hash_is_transparent<Transparent>::value, int>::type = 0>
+    const_iterator
+    find(const K& k) const
+    {
+        return find_iter(k, hash_key(k));
     }
 
     /**
@@ -1324,68 +3471,428 @@ public:
 
     template<typename T, typename std::enable_if<!std::is_lvalue_reference<T>::value, int>::type = 0>
     std::pair<iterator, bool>
-    insert(T&& v)
+    insert(T&& v)
+    {
+        return emplace(std::forward<decltype(v.first)>(v.first), std::forward<decltype(v.second)>(v.second));
+    }
+
+    /**
+     * @brief Insert every pair in [first,last), keeping the first
+     *        of equal keys as insert does. Into an empty container
+     *        without a write-ahead log, of trivially copyable keys
+     *        and values, the buckets are grown to fit, the pairs
+     *        radix sorted by bucket, on several threads when there
+     *        are many, and written left to right once. Otherwise
+     *        they are emplaced one at a time. Throws
+     *        std::length_error when more keys share a hash than
+     *        the layout can store, see compact_layout.
+     *
+     * @return size_type number of pairs inserted
+     */
+    template<typename ForwardIt>
+    size_type
+    bulk_load(ForwardIt first, ForwardIt last)
+    {
+        finish_resize();
+
+        const auto before = M_elem;
+        if (M_elem || M_wal || !relocatable)
+        {
+            for (; first != last; ++first)
+            {
+                emplace(first->first, first->second);
+            }
+
+            return M_elem - before;
+        }
+
+        struct record
+        {
+            size_type home;
+            size_type hash;
+            ForwardIt iter;
+            bool      kept;
+        };
+
+        std::vector<record> records;
+        for (; first != last; ++first)
+        {
+            if (!Layout::valid_key(first->first))
+            {
+                throw std::invalid_argument("key is reserved by the layout");
+            }
+
+            records.push_back({0, hash_key(first->first), first, false});
+        }
+
+        if (records.size() > max_elements())
+        {
+            reserve(records.size());
+        }
+
+        if (records.size() > M_buckets)
+        {
+            for (const auto& r : records)
+            {
+                emplace(r.iter->first, r.iter->second);
+            }
+
+            return M_elem - before;
+        }
+
+        size_type bits = 0;
+        while (bits != std::numeric_limits<size_type>::digits && (M_buckets - 1) >> bits)
+        {
+            ++bits;
+        }
+
+        for (auto& r : records)
+        {
+            r.home = reduce()(r.hash, M_buckets);
+        }
+
+        radix_sort(records, [](const record& r){ return r.home; }, bits, std::thread::hardware_concurrency());
+
+        /*  Ordered by hash in each bucket, so a key is only
+            compared with the keys sharing its hash however many
+            share its bucket. Stable, the first of equal keys is
+            still the one kept.
+        */
+        for (size_type begin = 0, end = 0; begin != records.size(); begin = end)
+        {
+            while (end != records.size() && records[end].home == records[begin].home)
+            {
+                ++end;
+            }
+
+            if (end - begin > 1)
+            {
+                std::stable_sort
+                (
+                    records.begin() + begin,
+                    records.begin() + end,
+                    [](const record& l, const record& r){ return l.hash < r.hash; }
+                );
+            }
+        }
+
+        using storage = typename std::aligned_storage<sizeof(element), alignof(element)>::type;
+        std::vector<storage> wrapped;
+
+        bool      fits = true;
+        size_type next = 0, run = 0;
+        for (size_type i = 0; i != records.size(); ++i)
+        {
+            auto& r = records[i];
+            if (records[run].hash != r.hash)
+            {
+                run = i;
+            }
+
+            /*  Equal keys have the same hash, so are in the same
+                run.
+            */
+            bool      seen   = false;
+            size_type shared = 0;
+            for (auto other = run; other != i && !seen; ++other)
+            {
+                if (records[other].kept)
+                {
+                    seen = records[other].iter->first == r.iter->first;
+                    ++shared;
+                }
+            }
+
+            if (seen)
+            {
+                continue;
+            }
+
+            /*  No number of buckets lets the layout store how far
+                more keys sharing a hash are from their bucket.
+            */
+            if (shared > Layout::max_displacement)
+            {
+                clear();
+                throw std::length_error("too many keys share a hash for the layout");
+            }
+            r.kept = true;
+
+            /*  Past the end wraps around, put back once the rest
+                is written.
+            */
+            const auto to   = std::max(r.home, next);
+            element*   at   = M_file + to;
+            size_type  disp = to - r.home;
+            if (to >= M_buckets)
+            {
+                wrapped.emplace_back();
+                at   = reinterpret_cast<element*>(&wrapped.back());
+                disp = 0;
+            }
+            else
+            {
+                fits = fits && disp <= Layout::max_displacement;
+                if (M_probe && disp > M_probe)
+                {
+                    M_probe_grow = true;
+                }
+
+                next = to + 1;
+            }
+
+            Layout::construct
+            (
+                at,
+                r.hash,
+                disp,
+                std::piecewise_construct,
+                std::forward_as_tuple(r.iter->first),
+                std::forward_as_tuple(r.iter->second)
+            );
+            ++M_elem;
+        }
+
+        for (const auto& kept : wrapped)
+        {
+            put_back(M_file, M_buckets, reinterpret_cast<const element*>(&kept));
+        }
+
+        rebuild_meta();
+        if (!fits)
+        {
+            grow();
+        }
+
+        return M_elem - before;
+    }
+
+    template<typename Arg, typename... Args>
+    std::pair<iterator, bool>
+    emplace(Arg&& arg, Args&&... args)
+    {
+        return emplace_dispatch(
+            std::is_same<typename std::decay<Arg>::type, Key>(),
+            std::forward<Arg>(arg), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Insert k with a value made from args, if k is not
+     *        in the container. Nothing is moved from k or args
+     *        when k exists.
+     */
+    template<typename... Args>
+    std::pair<iterator, bool>
+    try_emplace(const Key& k, Args&&... args)
+    {
+        return emplace_key(k, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool>
+    try_emplace(Key&& k, Args&&... args)
+    {
+        return emplace_key(std::move(k), std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename U>
+    std::pair<iterator, bool>
+    insert_or_assign(T&& k, U&& val)
+    {
+        /*  val is only moved from when inserted.
+        */
+        auto res = emplace(std::forward<T>(k), std::forward<U>(val));
+        if (!res.second && res.first != end())
+        {
+            res.first->second = std::forward<U>(val);
+
+            if (M_wal)
+            {
+                wal_log(wal_op::assign, iter_data(res.first) - M_file);
+            }
+        }
+
+        return res;
+    }
+
+private:
+
+    template<typename Arg, typename... Args>
+    std::pair<iterator, bool>
+    emplace_dispatch(std::true_type, Arg&& k, Args&&... args)
     {
-        return emplace(std::forward<decltype(v.first)>(v.first), std::forward<decltype(v.second)>(v.second));
+        return emplace_key(std::forward<Arg>(k), std::forward<Args>(args)...);
     }
 
     template<typename Arg, typename... Args>
     std::pair<iterator, bool>
-    emplace(Arg&& arg, Args&&... args)
+    emplace_dispatch(std::false_type, Arg&& arg, Args&&... args)
     {
-        Key k(std::forward<Arg>(arg));
-        const auto hashed = Hash()(k);
+        return emplace_key(Key(std::forward<Arg>(arg)), std::forward<Args>(args)...);
+    }
 
-        if (M_elem == M_buckets)
+    /**
+     * @brief Probe once for k, insert if not found. The element
+     *        is constructed in its bucket from k and args, only
+     *        when inserting. Throws std::invalid_argument if the
+     *        layout cannot store k, see sentinel_layout.
+     *
+     * @param k const Key& or Key&&
+     * @param args to construct the value from
+     * @return std::pair<iterator, bool> iterator to k and true
+     *                                   if inserted. end() and
+     *                                   false if k could not be
+     *                                   inserted
+     */
+    template<typename K, typename... Args>
+    std::pair<iterator, bool>
+    emplace_key(K&& k, Args&&... args)
+    {
+        const Key& key = k;
+        if (!Layout::valid_key(key))
         {
-            reserve_choice(M_buckets + 1, M_load, true, false, true);
+            throw std::invalid_argument("key is reserved by the layout");
         }
 
-        access temp(M_file, M_buckets);
-        const auto res = open_address_emplace_index<
-            access,
-            Key, size_type,
-            is_free, hash_comp, key_comp<Key>, elem_move,
-            hash_eq>
-        (temp, k, hashed, M_buckets);
+        const auto hashed = hash_key(key);
+        if (M_old)
+        {
+            resize_for(key, hashed);
+        }
 
-        if (!res.second)
+        size_type home, index, free, probe, overflow = 0;
+        bool grown = false;
+        auto temp  = make_access();
+        for (;;)
         {
-            return { make_iter(res.first),false };
+            home = reduce()(hashed, M_buckets);
+            const auto res = open_address_find<
+                access,
+                Key, size_type,
+                is_free, hash_comp, key_comp<Key>,
+                hash_eq>
+            (temp, key, home, M_buckets);
+
+            if (res.second)
+            {
+                return { make_iter(res.first),false };
+            }
+
+            /*  Only grow once the key is known to be new. Must
+                rehash rather than only reallocate, the modded
+                hash of every element changes.
+            */
+            if (!grown && (M_elem + 1 > max_elements() || (M_probe_grow && probe_grow_allowed())))
+            {
+                grown = true;
+                grow();
+                temp = make_access();
+                continue;
+            }
+
+            if (M_elem == M_buckets)
+            {
+                /*  Could not grow, at max size.
+                */
+                return { end(),false };
+            }
+
+            index = res.first;
+            free  = open_address_next_free<
+                access, size_type, is_free>
+            (temp, index, M_buckets);
+
+            probe = displacement(free, home, M_buckets);
+            if (probe <= Layout::max_displacement)
+            {
+                open_address_shift<
+                    access, size_type, elem_move>
+                (temp, index, free, M_buckets);
+                break;
+            }
+
+            /*  Layout cannot store how far elements would be
+                from their modded hash. More buckets do not
+                shorten a run of keys sharing a hash, give up
+                once growing did not bring the distance down.
+            */
+            if (overflow && probe >= overflow)
+            {
+                throw std::length_error("too many keys share a hash for the layout");
+            }
+            overflow = probe;
+
+            const auto before = M_buckets;
+            grow();
+            if (M_buckets == before)
+            {
+                return { end(),false };
+            }
+
+            temp = make_access();
         }
 
-        std::allocator_traits<allocator>::construct
+        Layout::construct
         (
-            M_alloc,
-            M_file + res.first,
-            false,
+            M_file + index,
             hashed,
-            std::make_pair(std::move(k), std::forward<Args>(args)...)
+            displacement(index, home, M_buckets),
+            std::piecewise_construct,
+            std::forward_as_tuple(std::forward<K>(k)),
+            std::forward_as_tuple(std::forward<Args>(args)...)
         );
- 
+        temp.set_ctrl(index, control_hash(hashed));
+
+        /*  Shifting only moves elements into the free bucket.
+        */
+        if (M_bits_built)
+        {
+            bitmap_set(M_bits.data(), free);
+            M_first = std::min(M_first, free);
+        }
+
         ++M_elem;
 
-        return { make_iter(res.first),true };
-    }
+        /*  Do not move the element just inserted, instead the
+            next insert will grow.
+        */
+        if (M_probe && probe > M_probe)
+        {
+            M_probe_grow = true;
+        }
 
-    template<typename T, typename U>
-    std::pair<iterator, bool>
-    insert_or_assign(T&& k, U&& val)
-    {
-        auto res = find(k);
-        if (res == end())
+        if (M_wal)
         {
-            return emplace(std::forward<T>(k), std::forward<U>(val));
+            wal_log(wal_op::insert, index);
         }
- 
-        res->second = std::forward<U>(val);
 
-        return { res,false };
+        return { make_iter(index),true };
     }
 
+public:
+
     iterator
     erase(const_iterator iter)
     {
+        if (M_old)
+        {
+            /*  Erasing takes a rehash step which moves elements,
+                the next is found again from its key.
+            */
+            const auto next = std::next(iter);
+            const Key  key  = iter->first;
+            if (next == cend())
+            {
+                erase_key(key);
+                return end();
+            }
+
+            const Key after = next->first;
+            erase_key(key);
+
+            return find(after);
+        }
+
         size_type index = iter_data(iter) - M_file;
         erase(access(M_file).key(index));
 
@@ -1399,6 +3906,58 @@ public:
 
     size_type
     erase(const_reference_key k)
+    {
+        return erase_key(k);
+    }
+
+    /**
+     * @brief Erase without making a key, only when Hash is
+     *        transparent.
+     */
+    template<typename K, typename Transparent = Hash,
+             typename std::enable_if<
+                hash_is_transparent<Transparent>::value &&
+                !std::is_convertible<K, const_iterator>::value &&
+                !std::is_convertible<K, iterator>::value, int>::type = 0>
+    size_type
+    erase(K&& k)
+    {
+        return erase_key(k);
+    }
+
+    bool
+    contains(const_reference_key k) const
+    {
+        return find(k) != cend();
+    }
+
+    template<typename K, typename Transparent = Hash,
+             typename std::enable_if<hash_is_transparent<Transparent>::value, int>::type = 0>
+    bool
+    contains(const K& k) const
+    {
+        return find(k) != cend();
+    }
+
+    size_type
+    count(const_reference_key k) const
+    {
+        return contains(k);
+    }
+
+    template<typename K, typename Transparent = Hash,
+             typename std::enable_if<hash_is_transparent<Transparent>::value, int>::type = 0>
+    size_type
+    count(const K& k) const
+    {
+        return contains(k);
+    }
+
+private:
+
+    template<typename K>
+    size_type
+    erase_key(const K& k)
     {
         struct local_deconstruct
         {
@@ -1414,30 +3973,46 @@ public:
             }
         };
 
-        access temp(M_file, M_buckets);
+        if (M_old)
+        {
+            resize_for(k, hash_key(k));
+        }
+
+        if (M_wal)
+        {
+            const auto found = find_index(k);
+            if (found == M_buckets)
+            {
+                return 0;
+            }
+
+            wal_log(wal_op::erase, found);
+        }
+
+        auto temp = make_access();
         auto res = open_address_erase_index<
             access,
-            key_type, size_type,
-            is_free, hash_comp, key_comp<key_type>, elem_move,
+            K, size_type,
+            is_free, hash_comp, key_comp<K>, elem_move,
             hash_eq, local_deconstruct>
-        (temp, k, Hash()(k), M_buckets);
+        (temp, k, reduce()(hash_key(k), M_buckets), M_buckets);
 
         if (res == M_buckets)
         {
             return 0;
         }
 
-        access(M_file).set_free(res, true);
+        temp.set_free(res);
+        if (M_bits_built)
+        {
+            bitmap_reset(M_bits.data(), res);
+        }
         --M_elem;
 
         return 1;
     }
 
-    bool
-    contains(const_reference_key k) const
-    {
-        return find(k) != cend();
-    }
+public:
 
     bool
     empty() const
@@ -1448,12 +4023,169 @@ public:
     void
     clear()
     {
-        for (size_type index = 0; index != M_buckets; ++index)
+        finish_resize();
+
+        if (M_wal)
+        {
+            wal_flush_assigned();
+            M_wal->append(wal_op::clear, nullptr, 0, nullptr, 0);
+            wal_group();
+        }
+
+        free_buckets(0, M_buckets);
+        std::fill(M_ctrl.begin(), M_ctrl.end(), control_empty);
+
+        std::fill(M_bits.begin(), M_bits.end(), 0);
+        M_first = M_buckets;
+        M_elem  = 0;
+    }
+
+    /**
+     * @brief When changes reach the file, see durability.h. The
+     *        default is durability_mode::on_close.
+     *
+     * @param period time between syncs for durability_mode::periodic
+     */
+    void
+    durability(durability_mode mode, std::chrono::milliseconds period = std::chrono::seconds(1))
+    {
+        M_flusher.reset();
+        M_durability = mode;
+
+        if (mode == durability_mode::periodic && is_file_backed<allocator>::value)
+        {
+            start_flusher(period);
+        }
+    }
+
+    durability_mode
+    durability() const
+    {
+        return M_durability;
+    }
+
+    /**
+     * @brief Write the buckets from first up to last to the file
+     *        and wait for it.
+     */
+    void
+    flush(const_iterator first, const_iterator last)
+    {
+        const auto lock = flush_lock();
+        const auto from = const_cast<element*>(iter_data(first));
+        sync_range(from, const_cast<element*>(iter_data(last)) - from);
+    }
+
+    /**
+     * @brief Write the whole file and wait for it.
+     */
+    void
+    sync()
+    {
+        finish_resize();
+
+        const auto lock = flush_lock();
+        if (M_file)
+        {
+            sync_range(M_file - header_slots(), M_buckets + header_slots());
+        }
+    }
+
+    /**
+     * @brief Syncs done so far, by any of the above or the
+     *        flusher.
+     */
+    flush_stats
+    flushed()
+    {
+        const auto lock = flush_lock();
+
+        return M_stats;
+    }
+
+    /**
+     * @brief How the file will be read, see access_pattern.h.
+     *        Kept across growth, rehash reads sequentially and
+     *        goes back to it. Give access_pattern::sequential
+     *        before iterating over a large container and
+     *        access_pattern::random for lookups.
+     */
+    void
+    advise(access_pattern pattern)
+    {
+        M_pattern = pattern;
+        if (M_file)
+        {
+            M_alloc.advise(M_file - header_slots(), M_buckets + header_slots(), pattern);
+        }
+    }
+
+    access_pattern
+    advice() const
+    {
+        return M_pattern;
+    }
+
+    /**
+     * @brief Read the whole file into memory now, so lookups after
+     *        opening an existing file do not each wait on a page
+     *        fault.
+     */
+    void
+    warmup()
+    {
+        if (M_file)
+        {
+            M_alloc.warmup(M_file - header_slots(), M_buckets + header_slots());
+        }
+    }
+
+    /**
+     * @brief Make every logged operation durable, nothing to do
+     *        without a log.
+     *
+     * @return false if writing the log failed
+     */
+    bool
+    commit()
+    {
+        M_wal_pending = 0;
+        if (!M_wal)
+        {
+            return true;
+        }
+
+        wal_flush_assigned();
+
+        return M_wal->commit();
+    }
+
+    /**
+     * @brief Copy the file as the new checkpoint and empty the
+     *        log, see write_ahead_log.h.
+     *
+     * @return false if there is no log or it failed
+     */
+    bool
+    checkpoint()
+    {
+        if (!M_wal || !write_checkpoint())
         {
-            access(M_file).set_free(index, true);
+            return false;
         }
 
-        M_elem = 0;
+        M_wal_pending = 0;
+
+        return M_wal->truncate();
+    }
+
+    /**
+     * @brief Number of syncs of the log, 0 without a log.
+     */
+    std::uint64_t
+    wal_commits()
+    {
+        return M_wal ? M_wal->commits() : 0;
     }
 
     size_type
@@ -1483,7 +4215,7 @@ public:
     size_type
     bucket(const_reference_key k) const
     {
-        return Hash()(k) % M_buckets;
+        return reduce()(hash_key(k), M_buckets);
     }
 
     float
@@ -1498,11 +4230,133 @@ public:
         return M_load;
     }
 
+    /**
+     * @brief Set the max load factor. The container will grow
+     *        before an insert would go over it.
+     *
+     * @param mlf in range (0,1], other values are ignored since
+     *            open addressing cannot hold more elements than
+     *            buckets
+     */
     void
-    max_load_factor(float mzlf)
+    max_load_factor(float mlf)
     {
-        /*  NOTE: remains unimplemented
-        */
+        if (!(mlf > 0 && mlf <= 1))
+        {
+            return;
+        }
+
+        M_load = mlf;
+        if (M_elem > max_elements())
+        {
+            rehash(M_elem);
+        }
+    }
+
+    /**
+     * @brief The longest probe an insert may do before the
+     *        container grows.
+     *
+     * @return size_type 0 when there is no limit
+     */
+    size_type
+    max_probe() const
+    {
+        return M_probe;
+    }
+
+    /**
+     * @brief Set the longest probe an insert may do before the
+     *        container grows. Probe length is the distance from
+     *        the modded hash of the key to the free bucket an
+     *        insert takes. Going over does not move the inserted
+     *        element, the next insert grows the container if it
+     *        is at least a quarter of the way to the max load
+     *        factor, see @ref probe_grow_allowed.
+     *
+     * @param probe 0 for no limit
+     */
+    void
+    max_probe(size_type probe)
+    {
+        M_probe = probe;
+    }
+
+    /**
+     * @brief Grow without stopping to move every element. When
+     *        an insert needs more buckets, new buckets are
+     *        allocated next to the old and each insert, erase and
+     *        find moves at least buckets of the old ones, ending
+     *        at a free bucket, until none are left. Lookups look
+     *        in both meanwhile.
+     *
+     *        While rehashing
+     *          - a find may move elements, as insert and erase
+     *            do, so iterators found earlier can be invalid
+     *          - an iterator to an element not moved yet is only
+     *            good to get at the element, not to move on from
+     *          - begin, rehash, clear, sync and checkpoint first
+     *            move everything left
+     *          - backed by a file the new buckets are in the file
+     *            with ".resize" added to its name, which replaces
+     *            the file once done. A crash loses the elements
+     *            moved so far, unless there is a write-ahead log
+     *
+     *        Positional layouts always rehash at once.
+     *
+     * @param buckets old buckets moved per operation, 0 to rehash
+     *                at once, the default
+     */
+    void
+    incremental_rehash(size_type buckets)
+    {
+        M_step = buckets;
+        if (!M_step)
+        {
+            finish_resize();
+        }
+    }
+
+    size_type
+    incremental_rehash() const
+    {
+        return M_step;
+    }
+
+    /**
+     * @brief Rehash by copying into a new file instead of moving
+     *        elements around in the file. The old buckets are
+     *        read in order and the copy, written beside the file
+     *        with ".resize" added to its name, is synced and then
+     *        renamed over it. A crash before the rename leaves
+     *        the file as it was, and other processes keep their
+     *        mapping of the old file until they reopen. Needs
+     *        room for both files meanwhile. Falls back to moving
+     *        in place if the copy cannot be allocated, or if Key
+     *        or Value is not trivially copyable.
+     *
+     *        Without a file the copy is new memory.
+     */
+    void
+    out_of_place_rehash(bool copy)
+    {
+        M_copy_rehash = copy;
+    }
+
+    bool
+    out_of_place_rehash() const
+    {
+        return M_copy_rehash;
+    }
+
+    /**
+     * @brief true while there are old buckets to move, see
+     *        incremental_rehash.
+     */
+    bool
+    rehashing() const
+    {
+        return M_old != nullptr;
     }
 
     /**
@@ -1564,7 +4418,42 @@ private:
     allocator         M_alloc;
     bool              M_delete;
     float             M_load;
+    size_type         M_probe;
+    bool              M_probe_grow;
     element*          M_file;
+    std::vector<unsigned char> M_ctrl;
+    mutable std::vector<std::uint64_t> M_bits;
+    mutable size_type M_first;
+    mutable bool      M_bits_built;
+
+    durability_mode                   M_durability;
+    std::unique_ptr<periodic_flusher> M_flusher;
+    flush_stats                       M_stats;
+    access_pattern                    M_pattern;
+
+    /*  Buckets being moved out of while rehashing incrementally,
+        M_old is nullptr otherwise. M_old_left buckets from
+        M_old_at are still to be looked at.
+    */
+    allocator M_old_alloc;
+    element*  M_old;
+    size_type M_old_buckets;
+    size_type M_old_at;
+    size_type M_old_left;
+    size_type M_step;
+
+    bool M_copy_rehash;
+
+    std::unique_ptr<write_ahead_log> M_wal;
+    std::string                      M_wal_base;
+    size_type                        M_wal_group;
+    size_type                        M_wal_pending;
+
+    /*  Key last given out by operator[] with a log, its value
+        is still to be logged when M_wal_assigned.
+    */
+    typename std::aligned_storage<sizeof(Key), alignof(Key)>::type M_wal_key;
+    bool                                                             M_wal_assigned;
     std::vector<std::size_t> M_bucket_choices =
     {
         1,
@@ -0,0 +1,418 @@
+#ifndef CUSTOM_FILE_LIBRARY_WRITE_AHEAD_LOG
+#define CUSTOM_FILE_LIBRARY_WRITE_AHEAD_LOG
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "defs.h"
+
+/*  An append only log of the operations done on a container, kept
+    next to its file, so that a crash loses at most the operations
+    not yet committed.
+
+    A checkpoint is a copy of the synced file, after which the log
+    is emptied. Opening a file not closed cleanly goes back to the
+    checkpoint, or to empty when there is none, and replays the
+    log. Nothing written to the file itself after the checkpoint
+    is trusted, so the order pages reach the disk does not matter.
+    Closing cleanly keeps the checkpoint and log, reopening carries
+    on the log without copying the file.
+
+    Records are
+
+        std::uint32_t   size of the payload
+        std::uint8_t    wal_op
+        std::uint8_t    padding[3]
+        std::uint64_t   FNV-1a of the op and payload
+        payload         key, then value for insert and assign
+
+    Replay stops at the first record cut short or with the wrong
+    checksum, a commit torn by the crash.
+
+    Committing is grouped. Operations are appended to a buffer, the
+    first thread to commit writes and syncs everything appended so
+    far, the threads committing meanwhile wait for it and find
+    their records already synced.
+*/
+
+FILE_NAMESPACE_BEGIN
+
+enum class wal_op : std::uint8_t
+{
+    insert = 1,
+    assign = 2,
+    erase  = 3,
+    clear  = 4
+};
+
+/**
+ * @brief Given to a constructor of a container to keep a log,
+ *        group_ops operations are committed together, 1 to
+ *        commit each.
+ */
+struct write_ahead
+{
+    std::size_t group_ops;
+};
+
+/**
+ * @brief Copy the file from into to, sharing the blocks when
+ *        the file system can. to is written under a temporary
+ *        name and renamed, so it is either the old or the new.
+ *
+ * @return false if there is no file from or copying failed
+ */
+inline bool
+copy_file(const std::string& from, const std::string& to)
+{
+    const int in = ::open(from.c_str(), O_RDONLY);
+    if (in == -1)
+    {
+        return false;
+    }
+
+    const auto temp = to + ".tmp";
+    const int  out  = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (out == -1)
+    {
+        ::close(in);
+        return false;
+    }
+
+    bool copied = ::ioctl(out, FICLONE, in) == 0;
+    if (!copied)
+    {
+        struct stat64 st;
+        copied = ::fstat64(in, &st) == 0;
+
+        loff_t left = copied ? st.st_size : 0;
+        while (copied && left > 0)
+        {
+            const auto n = ::copy_file_range(in, nullptr, out, nullptr, left, 0);
+            copied = n > 0;
+            left  -= n;
+        }
+    }
+
+    copied = copied && ::fsync(out) == 0;
+    ::close(in);
+    copied = ::close(out) == 0 && copied;
+
+    if (!copied || ::rename(temp.c_str(), to.c_str()))
+    {
+        ::remove(temp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+class write_ahead_log
+{
+public:
+
+    /**
+     * @brief Open the log at name, creating it if there is none.
+     *        Records already in it are kept for replay.
+     */
+    explicit write_ahead_log(std::string name) :
+        M_name(std::move(name)),
+        M_fd(::open(M_name.c_str(), O_RDWR | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR)),
+        M_appended(0),
+        M_durable(0),
+        M_size(0),
+        M_failed(false),
+        M_syncing(false),
+        M_commits(0)
+    {
+        struct stat64 st;
+        if (M_fd != -1 && ::fstat64(M_fd, &st) == 0)
+        {
+            M_size = st.st_size;
+        }
+    }
+
+    write_ahead_log(const write_ahead_log&) = delete;
+    write_ahead_log& operator=(const write_ahead_log&) = delete;
+
+    ~write_ahead_log()
+    {
+        commit();
+
+        if (M_fd != -1)
+        {
+            ::close(M_fd);
+        }
+    }
+
+    bool
+    is_open() const
+    {
+        return M_fd != -1;
+    }
+
+    const std::string&
+    name() const
+    {
+        return M_name;
+    }
+
+    /**
+     * @brief Add a record, it is only durable once committed.
+     *
+     * @return std::uint64_t number of the record, to give to commit
+     */
+    std::uint64_t
+    append(wal_op op, const void* key, std::size_t key_size, const void* value, std::size_t value_size)
+    {
+        const std::uint32_t size = key_size + value_size;
+        const auto          code = static_cast<std::uint8_t>(op);
+
+        std::uint64_t sum = checksum(offset_basis, &code, 1);
+        sum = checksum(sum, key, key_size);
+        sum = checksum(sum, value, value_size);
+
+        std::lock_guard<std::mutex> guard(M_mutex);
+
+        const auto at = M_buffer.size();
+        M_buffer.resize(at + header_size + size);
+
+        auto p = M_buffer.data() + at;
+        std::memcpy(p, &size, sizeof(size));
+        std::memcpy(p + 4, &code, 1);
+        std::memset(p + 5, 0, 3);
+        std::memcpy(p + 8, &sum, sizeof(sum));
+        if (key_size)
+        {
+            std::memcpy(p + header_size, key, key_size);
+        }
+        if (value_size)
+        {
+            std::memcpy(p + header_size + key_size, value, value_size);
+        }
+
+        return ++M_appended;
+    }
+
+    /**
+     * @brief Make every record up to number lsn durable, joining
+     *        a sync already running when it covers them. When
+     *        writing or syncing fails the file is cut back to its
+     *        durable records, so a torn record does not hide the
+     *        later ones from replay, and the records are kept to
+     *        be written by the next commit. If the file cannot be
+     *        cut back every later commit fails.
+     *
+     * @return false if writing or syncing failed
+     */
+    bool
+    commit(std::uint64_t lsn)
+    {
+        std::unique_lock<std::mutex> lock(M_mutex);
+        while (M_durable < lsn)
+        {
+            if (M_failed)
+            {
+                return false;
+            }
+
+            if (M_syncing)
+            {
+                M_cond.wait(lock);
+                continue;
+            }
+
+            M_syncing = true;
+            std::vector<char> buffer;
+            buffer.swap(M_buffer);
+            const auto upto = M_appended;
+            lock.unlock();
+
+            const bool written = write_all(buffer) && ::fdatasync(M_fd) == 0;
+            const bool cut     = written || ::ftruncate64(M_fd, M_size) == 0;
+
+            lock.lock();
+            M_syncing = false;
+            M_cond.notify_all();
+            if (!written)
+            {
+                /*  Records appended meanwhile go after these.
+                */
+                buffer.insert(buffer.end(), M_buffer.begin(), M_buffer.end());
+                M_buffer.swap(buffer);
+                M_failed = !cut;
+
+                return false;
+            }
+
+            M_durable = upto;
+            M_size   += buffer.size();
+            ++M_commits;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Make every record appended so far durable.
+     */
+    bool
+    commit()
+    {
+        std::uint64_t lsn;
+        {
+            std::lock_guard<std::mutex> guard(M_mutex);
+            lsn = M_appended;
+        }
+
+        return commit(lsn);
+    }
+
+    /**
+     * @brief Number of syncs done, records committed together
+     *        share one.
+     */
+    std::uint64_t
+    commits()
+    {
+        std::lock_guard<std::mutex> guard(M_mutex);
+
+        return M_commits;
+    }
+
+    /**
+     * @brief Call f(op, payload, size) for every whole record in
+     *        the file, in order.
+     *
+     * @return std::size_t number of records replayed
+     */
+    template<typename F>
+    std::size_t
+    replay(F f)
+    {
+        std::vector<char> data;
+        struct stat64 st;
+        if (::fstat64(M_fd, &st) || st.st_size == 0)
+        {
+            return 0;
+        }
+
+        data.resize(st.st_size);
+        std::size_t read = 0;
+        while (read != data.size())
+        {
+            const auto n = ::pread64(M_fd, data.data() + read, data.size() - read, read);
+            if (n <= 0)
+            {
+                break;
+            }
+            read += n;
+        }
+
+        std::size_t count = 0;
+        for (std::size_t at = 0; at + header_size <= read; ++count)
+        {
+            std::uint32_t size;
+            std::uint64_t sum;
+            const auto    p = data.data() + at;
+            std::memcpy(&size, p, sizeof(size));
+            std::memcpy(&sum, p + 8, sizeof(sum));
+
+            if (at + header_size + size > read ||
+                checksum(checksum(offset_basis, p + 4, 1), p + header_size, size) != sum)
+            {
+                break;
+            }
+
+            f(static_cast<wal_op>(p[4]), p + header_size, static_cast<std::size_t>(size));
+            at += header_size + size;
+        }
+
+        return count;
+    }
+
+    /**
+     * @brief Drop every record, committed or not. Done once they
+     *        are all in a checkpoint.
+     */
+    bool
+    truncate()
+    {
+        std::unique_lock<std::mutex> lock(M_mutex);
+        M_cond.wait(lock, [this]{ return !M_syncing; });
+
+        M_buffer.clear();
+        M_durable = M_appended;
+        M_size    = 0;
+
+        const bool cut = ::ftruncate64(M_fd, 0) == 0 && ::fdatasync(M_fd) == 0;
+        M_failed = !cut;
+
+        return cut;
+    }
+
+private:
+
+    static constexpr std::size_t   header_size  = 16;
+    static constexpr std::uint64_t offset_basis = 0xcbf29ce484222325ull;
+
+    static std::uint64_t
+    checksum(std::uint64_t hash, const void* data, std::size_t size)
+    {
+        const auto p = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i != size; ++i)
+        {
+            hash ^= p[i];
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash;
+    }
+
+    bool
+    write_all(const std::vector<char>& buffer)
+    {
+        std::size_t written = 0;
+        while (written != buffer.size())
+        {
+            const auto n = ::write(M_fd, buffer.data() + written, buffer.size() - written);
+            if (n <= 0)
+            {
+                return false;
+            }
+            written += n;
+        }
+
+        return true;
+    }
+
+    const std::string M_name;
+    const int         M_fd;
+
+    std::mutex              M_mutex;
+    std::condition_variable M_cond;
+    std::vector<char>       M_buffer;
+    std::uint64_t           M_appended;
+    std::uint64_t           M_durable;
+    std::uint64_t           M_size;
+    bool                    M_failed;
+    bool                    M_syncing;
+    std::uint64_t           M_commits;
+
+};
+
+FILE_NAMESPACE_END
+
+#endif
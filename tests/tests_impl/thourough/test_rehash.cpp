@@ -81,6 +81,33 @@ TEST_F(TestRehash, GrowA)
     erase_and_check(3);
 }
 
+TEST_F(TestRehash, GrowCycle)
+{
+    /*  Every element moves to the index of the next,
+        the last to the index of the first.
+
+        0 (0,9)
+        1 (1,10)
+        2 (2,8)
+
+        0 (0,8)
+        1 (1,9)
+        2 (2,10)
+        3
+    */
+
+    cont.bucket_choices({3,4});
+    cont.reserve(3);
+
+    insert({9,10,8});
+
+    cont.rehash(4);
+
+    erase_and_check(0);
+    erase_and_check(1);
+    erase_and_check(2);
+}
+
 TEST_F(TestRehash, GrowB)
 {
     /*  0 (0,80)
@@ -0,0 +1,144 @@
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <files/access_pattern.h>
+#include <files/basic_allocator.h>
+#include <files/unordered_map.h>
+
+using namespace MmapFiles;
+
+using Map = unordered_map_file<std::size_t, std::size_t>;
+
+/*  The advice and the resident pages of a mapping are read back
+    from /proc/self/smaps.
+*/
+class AccessPatternTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "access_pattern_test.dat";
+
+    AccessPatternTest()
+    {
+        std::remove(name.c_str());
+    }
+
+    ~AccessPatternTest()
+    {
+        std::remove(name.c_str());
+    }
+
+    /*  The line of the mapping of name starting with field, empty
+        if there is none.
+    */
+    std::string
+    smaps(const std::string& field)
+    {
+        std::ifstream in("/proc/self/smaps");
+        std::string   line;
+        bool          mapping = false;
+        while (std::getline(in, line))
+        {
+            if (line.find('-') < line.find(' '))
+            {
+                mapping = line.size() > name.size() &&
+                          line.compare(line.size() - name.size() - 1, std::string::npos, "/" + name) == 0;
+            }
+            else if (mapping && line.compare(0, field.size(), field) == 0)
+            {
+                return line;
+            }
+        }
+
+        return {};
+    }
+
+    bool
+    has_flag(const std::string& flag)
+    {
+        return smaps("VmFlags:").find(" " + flag) != std::string::npos;
+    }
+
+    std::size_t
+    rss_kb()
+    {
+        const auto line = smaps("Rss:");
+
+        return line.empty() ? 0 : std::stoul(line.substr(4));
+    }
+};
+
+TEST_F(AccessPatternTest, Advise)
+{
+    Map cont(name, 8, false);
+    ASSERT_EQ(cont.advice(), access_pattern::normal);
+
+    cont.advise(access_pattern::random);
+    ASSERT_TRUE(has_flag("rr"));
+
+    // kept over growth and rehash
+    for (std::size_t i = 0; i != 20000; ++i)
+    {
+        cont.emplace(i, i);
+    }
+    cont.rehash(100000);
+    ASSERT_EQ(cont.advice(), access_pattern::random);
+    ASSERT_TRUE(has_flag("rr"));
+    ASSERT_FALSE(has_flag("sr"));
+
+    cont.advise(access_pattern::sequential);
+    ASSERT_TRUE(has_flag("sr"));
+    ASSERT_FALSE(has_flag("rr"));
+
+    std::size_t count = 0;
+    for (auto& kv : cont)
+    {
+        ASSERT_EQ(kv.first, kv.second);
+        ++count;
+    }
+    ASSERT_EQ(count, 20000u);
+
+    cont.advise(access_pattern::normal);
+    ASSERT_FALSE(has_flag("sr"));
+    ASSERT_FALSE(has_flag("rr"));
+}
+
+TEST_F(AccessPatternTest, Warmup)
+{
+    std::size_t buckets = 0;
+    {
+        Map cont(name, 8, false);
+        for (std::size_t i = 0; i != 100000; ++i)
+        {
+            cont.emplace(i, i);
+        }
+        buckets = cont.bucket_count();
+    }
+
+    Map cont(name, 8, true);
+    const auto before = rss_kb();
+    cont.warmup();
+    ASSERT_GE(rss_kb(), before + buckets * 2 * sizeof(std::size_t) / 1024 / 2);
+
+    for (std::size_t i = 0; i != 100000; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i);
+    }
+}
+
+TEST(AccessPattern, NotFileBacked)
+{
+    unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>, basic_allocator> cont;
+    cont.emplace(1, 1);
+    cont.advise(access_pattern::random);
+    cont.warmup();
+    cont.rehash(100);
+    ASSERT_EQ(cont.advice(), access_pattern::random);
+    ASSERT_EQ(cont.find(1)->second, 1u);
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/radix_sort.h>
+#include <files/slot_layout.h>
+#include <files/unordered_map.h>
+#include <tests_support/Funcs.h>
+
+using namespace MmapFiles;
+
+using Map = unordered_map_file<std::size_t, std::size_t>;
+
+class BulkLoadTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "bulk_load_test.dat";
+
+    BulkLoadTest()
+    {
+        std::remove(name.c_str());
+    }
+
+    ~BulkLoadTest()
+    {
+        std::remove(name.c_str());
+    }
+};
+
+TEST(RadixSort, Stable)
+{
+    std::vector<std::pair<std::size_t, std::size_t>> records, expected;
+
+    std::size_t state = 7;
+    for (std::size_t i = 0; i != 300000; ++i)
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        records.emplace_back((state >> 40) % 100000, i);
+    }
+
+    expected = records;
+    std::stable_sort(expected.begin(), expected.end(), [](const std::pair<std::size_t, std::size_t>& a,
+                                                          const std::pair<std::size_t, std::size_t>& b)
+    {
+        return a.first < b.first;
+    });
+
+    radix_sort(records, [](const std::pair<std::size_t, std::size_t>& r){ return r.first; }, 17, 4);
+    ASSERT_EQ(records, expected);
+}
+
+TEST_F(BulkLoadTest, Construct)
+{
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    for (std::size_t i = 0; i != 100000; ++i)
+    {
+        pairs.emplace_back(i * 3, i);
+    }
+    // later duplicates are not inserted
+    pairs.emplace_back(3, 7);
+    pairs.emplace_back(6, 7);
+
+    {
+        Map cont(name, pairs.begin(), pairs.end());
+        ASSERT_EQ(cont.size(), 100000u);
+
+        for (std::size_t i = 0; i != 100000; ++i)
+        {
+            ASSERT_EQ(cont.find(i * 3)->second, i) << "key " << i * 3;
+            ASSERT_FALSE(cont.contains(i * 3 + 1));
+        }
+
+        // the layout is the one inserts would keep up
+        for (std::size_t i = 0; i < 100000; i += 2)
+        {
+            ASSERT_EQ(cont.erase(i * 3), 1u);
+        }
+        for (std::size_t i = 0; i != 100000; ++i)
+        {
+            ASSERT_EQ(cont.contains(i * 3), i % 2 == 1) << "key " << i * 3;
+        }
+    }
+
+    Map cont(name, 8, true);
+    ASSERT_EQ(cont.size(), 50000u);
+}
+
+TEST(BulkLoad, NotEmpty)
+{
+    unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>, basic_allocator> cont;
+    cont.emplace(1, 10);
+
+    const std::vector<std::pair<std::size_t, std::size_t>> pairs = {{1, 1}, {2, 2}, {3, 3}};
+    ASSERT_EQ(cont.bulk_load(pairs.begin(), pairs.end()), 2u);
+    ASSERT_EQ(cont.find(1)->second, 10u);
+    ASSERT_EQ(cont.find(3)->second, 3u);
+}
+
+TEST(BulkLoad, NotTrivial)
+{
+    // std::string is not written as bytes, the pairs are emplaced
+    std::vector<std::pair<std::size_t, std::string>> pairs;
+    for (std::size_t i = 0; i != 1000; ++i)
+    {
+        pairs.emplace_back(i % 800, long_value(i));
+    }
+
+    unordered_map_file<std::size_t, std::string, std::hash<std::size_t>, basic_allocator> cont;
+    ASSERT_EQ(cont.bulk_load(pairs.begin(), pairs.end()), 800u);
+    check_long_values(cont, 800);
+}
+
+TEST(BulkLoad, Wrapped)
+{
+    // the last buckets overflow around the end
+    struct Last
+    {
+        std::size_t
+        operator()(std::size_t k) const
+        {
+            return k < 20 ? 127 : k;
+        }
+    };
+
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        pairs.emplace_back(i, i);
+    }
+
+    unordered_map_file<
+        std::size_t, std::size_t,
+        Last,
+        basic_allocator,
+        prime_growth_policy<>,
+        true,
+        compact_layout<>> cont(pairs.begin(), pairs.end());
+
+    ASSERT_EQ(cont.size(), 100u);
+    for (std::size_t i = 0; i < 100; i += 3)
+    {
+        ASSERT_EQ(cont.erase(i), 1u);
+    }
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        ASSERT_EQ(cont.contains(i), i % 3 != 0) << "key " << i;
+    }
+}
+
+TEST(BulkLoad, Clustered)
+{
+    // every key has the same bucket, but its own hash
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    for (std::size_t i = 0; i != 100000; ++i)
+    {
+        pairs.emplace_back(i << 32, i);
+    }
+    pairs.emplace_back(std::size_t(5) << 32, 7);
+
+    unordered_map_file<
+        std::size_t, std::size_t,
+        std::hash<std::size_t>,
+        basic_allocator,
+        power_of_two_growth_policy<mask_reduce<false>>> cont(pairs.begin(), pairs.end());
+
+    ASSERT_EQ(cont.size(), 100000u);
+    ASSERT_EQ(cont.find(std::size_t(5) << 32)->second, 5u);
+    for (std::size_t i = 0; i < 100000; i += 997)
+    {
+        ASSERT_EQ(cont.find(i << 32)->second, i) << "key " << (i << 32);
+    }
+}
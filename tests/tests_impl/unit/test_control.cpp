@@ -0,0 +1,98 @@
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/control_group.h>
+#include <files/unordered_map.h>
+#include <tests_support/Funcs.h>
+
+using namespace MmapFiles;
+
+TEST(ControlGroup, Match)
+{
+    constexpr auto width = control_group::width;
+
+    std::vector<unsigned char> ctrl(width, control_empty);
+    ctrl[0]         = 0x12;
+    ctrl[width - 1] = 0x12;
+    ctrl[width / 2] = 0x7f;
+
+    const control_group group(ctrl.data());
+
+    const std::uint32_t ends = 1 | (std::uint32_t(1) << (width - 1));
+    ASSERT_EQ(group.match(0x12), ends);
+    ASSERT_EQ(group.match(0x7f), std::uint32_t(1) << (width / 2));
+    ASSERT_EQ(group.match(0x13), 0);
+
+    // every byte but the three taken
+    const std::uint32_t all = width == 32 ? ~std::uint32_t(0) : (std::uint32_t(1) << width) - 1;
+    ASSERT_EQ(group.match_empty(), all & ~(ends | (std::uint32_t(1) << (width / 2))));
+}
+
+TEST(ControlGroup, Hash)
+{
+    for (std::size_t i = 0; i != 1000; ++i)
+    {
+        ASSERT_NE(control_hash(i * 0x9e3779b97f4a7c15ull), control_empty);
+    }
+
+    // only the high bits differ
+    ASSERT_NE(control_hash(0), control_hash(std::size_t(1) << 60));
+}
+
+/*  Few buckets and a weak hash so clusters are long, wrap
+    around, and span several groups.
+*/
+struct CollideHash
+{
+    std::size_t
+    operator()(std::size_t k) const
+    {
+        return k % 5;
+    }
+};
+
+template<typename Hash>
+using ControlMap = unordered_map_file<
+    std::size_t,
+    std::size_t,
+    Hash,
+    basic_allocator,
+    prime_growth_policy<>,
+    true>;
+
+TEST(ControlMap, CollidingDifferential)
+{
+    ControlMap<CollideHash> cont;
+    cont.bucket_choices({7, 13, 31, 61, 127});
+    compare_with_std(cont, 100, 20000);
+}
+
+TEST(ControlMap, FullTable)
+{
+    ControlMap<CollideHash> cont;
+    cont.bucket_choices({61});
+    cont.rehash(61);
+
+    // every bucket taken, search must stop after one lap
+    for (std::size_t k = 0; k != 61; ++k)
+    {
+        ASSERT_TRUE(cont.emplace(k, k).second);
+    }
+    ASSERT_EQ(cont.bucket_count(), 61);
+
+    for (std::size_t k = 0; k != 61; ++k)
+    {
+        ASSERT_TRUE(cont.contains(k));
+    }
+    ASSERT_FALSE(cont.contains(61));
+}
+
+TEST(ControlMap, Differential)
+{
+    ControlMap<std::hash<std::size_t>> cont;
+    compare_with_std(cont, 5000, 50000);
+}
@@ -0,0 +1,137 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/durability.h>
+#include <files/unordered_map.h>
+
+using namespace MmapFiles;
+
+using Map = unordered_map_file<std::size_t, std::size_t>;
+
+class DurabilityTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "durability_test.dat";
+
+    DurabilityTest()
+    {
+        std::remove(name.c_str());
+    }
+
+    ~DurabilityTest()
+    {
+        std::remove(name.c_str());
+    }
+
+    /*  Wait for the flusher of cont to have run at least once.
+    */
+    static bool
+    wait_flushed(Map& cont)
+    {
+        for (int i = 0; i != 200; ++i)
+        {
+            if (cont.flushed().flushes)
+            {
+                return true;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        return false;
+    }
+};
+
+TEST_F(DurabilityTest, Explicit)
+{
+    Map cont(name, 1000, false);
+    ASSERT_EQ(cont.durability(), durability_mode::on_close);
+    ASSERT_EQ(cont.flushed().flushes, 0u);
+
+    for (std::size_t i = 0; i != 500; ++i)
+    {
+        cont.emplace(i, i);
+    }
+
+    cont.sync();
+    auto stats = cont.flushed();
+    ASSERT_EQ(stats.flushes, 1u);
+    ASSERT_GE(stats.bytes, cont.bucket_count() * sizeof(std::size_t) * 2);
+
+    cont.flush(cont.find(10), std::next(cont.find(10)));
+    ASSERT_EQ(cont.flushed().flushes, 2u);
+    ASSERT_GE(cont.flushed().bytes, stats.bytes + 4096);
+}
+
+TEST_F(DurabilityTest, Periodic)
+{
+    Map cont(name, 8, false);
+    cont.durability(durability_mode::periodic, std::chrono::milliseconds(1));
+
+    // grows while the flusher runs
+    for (std::size_t i = 0; i != 20000; ++i)
+    {
+        cont.emplace(i, i);
+    }
+
+    ASSERT_TRUE(wait_flushed(cont));
+
+    cont.durability(durability_mode::none);
+    const auto stats = cont.flushed();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_EQ(cont.flushed().flushes, stats.flushes);
+
+    for (std::size_t i = 0; i != 20000; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i);
+    }
+}
+
+TEST_F(DurabilityTest, MovePeriodic)
+{
+    Map from(name, 8, false);
+    from.durability(durability_mode::periodic, std::chrono::milliseconds(1));
+    from.emplace(1, 1);
+
+    Map cont(std::move(from));
+    ASSERT_EQ(cont.durability(), durability_mode::periodic);
+
+    const auto before = cont.flushed().flushes;
+    for (int i = 0; i != 200 && cont.flushed().flushes == before; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GT(cont.flushed().flushes, before);
+    ASSERT_EQ(cont.find(1)->second, 1u);
+}
+
+TEST_F(DurabilityTest, Reopen)
+{
+    {
+        Map cont(name, 8, false);
+        cont.durability(durability_mode::none);
+        cont.emplace(7, 7);
+    }
+
+    Map cont(name, 8, true);
+    ASSERT_EQ(cont.find(7)->second, 7u);
+}
+
+TEST(Durability, NotFileBacked)
+{
+    unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>, basic_allocator> cont;
+    cont.emplace(1, 1);
+    cont.sync();
+    cont.durability(durability_mode::periodic);
+    ASSERT_EQ(cont.flushed().flushes, 0u);
+    ASSERT_EQ(cont.flushed().bytes, 0u);
+}
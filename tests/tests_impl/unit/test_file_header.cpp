@@ -0,0 +1,149 @@
+#include <cstddef>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/file_header.h>
+#include <files/unordered_map.h>
+
+using namespace MmapFiles;
+
+/*  Reopening a file reads the number of buckets and elements
+    from its header.
+*/
+class FileHeaderTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "file_header_test.dat";
+
+    FileHeaderTest()
+    {
+        std::remove(name.c_str());
+    }
+
+    ~FileHeaderTest()
+    {
+        std::remove(name.c_str());
+    }
+};
+
+TEST_F(FileHeaderTest, Reopen)
+{
+    std::size_t buckets = 0;
+    {
+        unordered_map_file<std::size_t, int> cont(name, 64, false);
+        for (int i = 0; i < 1000; ++i)
+        {
+            cont.emplace(i, i);
+        }
+
+        buckets = cont.bucket_count();
+    }
+
+    // the bucket count given is ignored for an existing file
+    unordered_map_file<std::size_t, int> cont(name, 1, true);
+    ASSERT_EQ(cont.bucket_count(), buckets);
+    ASSERT_EQ(cont.size(), 1000u);
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto it = cont.find(i);
+        ASSERT_NE(it, cont.end());
+        ASSERT_EQ(it->second, i);
+    }
+
+    cont.emplace(5000, -1);
+    ASSERT_EQ(cont.size(), 1001u);
+    ASSERT_EQ(std::distance(cont.begin(), cont.end()), 1001);
+}
+
+TEST_F(FileHeaderTest, ReopenKeepsSettings)
+{
+    {
+        unordered_map_file<std::size_t, int> cont(name, 64, false);
+        cont.max_load_factor(0.5f);
+        cont.max_probe(7);
+        cont.emplace(1, 1);
+    }
+
+    unordered_map_file<std::size_t, int> cont(name, 1, true);
+    ASSERT_FLOAT_EQ(cont.max_load_factor(), 0.5f);
+    ASSERT_EQ(cont.max_probe(), 7u);
+    ASSERT_EQ(cont.count(1), 1u);
+}
+
+TEST_F(FileHeaderTest, NoFile)
+{
+    unordered_map_file<std::size_t, int> cont(name, 64, true);
+    ASSERT_EQ(cont.size(), 0u);
+    ASSERT_GE(cont.bucket_count(), 64u);
+}
+
+TEST_F(FileHeaderTest, Unclean)
+{
+    {
+        unordered_map_file<std::size_t, int> cont(name, 64, false);
+        cont.emplace(1, 1);
+        cont.emplace(2, 2);
+    }
+
+    // as if the process died before the destructor ran,
+    // the elements must then be counted
+    {
+        std::FILE* f = std::fopen(name.c_str(), "r+b");
+        ASSERT_NE(f, nullptr);
+
+        file_header h;
+        ASSERT_EQ(std::fread(&h, sizeof(h), 1, f), 1u);
+        ASSERT_EQ(h.clean, 1u);
+        ASSERT_EQ(h.elements, 2u);
+
+        h.clean    = 0;
+        h.elements = 100;
+        std::rewind(f);
+        ASSERT_EQ(std::fwrite(&h, sizeof(h), 1, f), 1u);
+        std::fclose(f);
+    }
+
+    unordered_map_file<std::size_t, int> cont(name, 1, true);
+    ASSERT_EQ(cont.size(), 2u);
+}
+
+TEST_F(FileHeaderTest, WrongTypes)
+{
+    {
+        unordered_map_file<std::size_t, int> cont(name, 64, false);
+        cont.emplace(1, 1);
+    }
+
+    using other = unordered_map_file<std::size_t, long>;
+    ASSERT_THROW(other(name, 1, true), std::runtime_error);
+}
+
+TEST(FileHeader, Fingerprint)
+{
+    ASSERT_EQ((type_fingerprint<int, long>()), (type_fingerprint<int, long>()));
+    ASSERT_NE((type_fingerprint<int, long>()), (type_fingerprint<long, int>()));
+    ASSERT_NE((type_fingerprint<int>()), (type_fingerprint<int, int>()));
+}
+
+TEST(FileHeader, FileBacked)
+{
+    ASSERT_TRUE(is_file_backed<mmap_allocator<int>>::value);
+    ASSERT_FALSE(is_file_backed<std::allocator<int>>::value);
+}
+
+TEST(FileHeader, BasicAllocator)
+{
+    // the constructor builds without a file to open
+    unordered_map_file<int, int, std::hash<int>, basic_allocator> cont("not_a_file.dat", 16, false);
+    ASSERT_EQ(cont.size(), 0u);
+    ASSERT_TRUE(cont.emplace(1, 1).second);
+    ASSERT_EQ(cont.find(1)->second, 1);
+}
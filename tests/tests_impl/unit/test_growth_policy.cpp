@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/growth_policy.h>
+#include <files/unordered_map.h>
+#include <tests_support/Funcs.h>
+
+using namespace MmapFiles;
+
+template<typename Policy>
+class GrowthPolicyTest :
+    public testing::Test
+{
+protected:
+
+    Policy policy;
+
+};
+
+using MyPolicies = testing::Types
+<
+    prime_growth_policy<>,
+    prime_growth_policy<fastrange_reduce<>>,
+    geometric_growth_policy<>,
+    power_of_two_growth_policy<>,
+    power_of_two_growth_policy<fastrange_reduce<false>>
+>;
+TYPED_TEST_SUITE(GrowthPolicyTest, MyPolicies);
+
+TYPED_TEST(GrowthPolicyTest, NextPrev)
+{
+    for (std::size_t n = 1; n != 5000; ++n)
+    {
+        const auto next = this->policy.next(n);
+        const auto prev = this->policy.prev(n);
+
+        // below the fewest buckets prev gives the fewest
+        const auto least = this->policy.next(1);
+
+        ASSERT_GE(next, n);
+        ASSERT_LE(prev, std::max(n, least));
+        ASSERT_GE(prev, 1);
+
+        // both are sizes of the policy
+        ASSERT_EQ(this->policy.next(next), next);
+        ASSERT_EQ(this->policy.prev(prev), prev);
+    }
+}
+
+TYPED_TEST(GrowthPolicyTest, Geometric)
+{
+    /*  Growing one past a size must at least get
+        a 1.5x larger size, for large enough sizes.
+    */
+    for (std::size_t n = this->policy.next(1000); n < (std::size_t(1) << 40);)
+    {
+        const auto next = this->policy.next(n + 1);
+        ASSERT_GE(next, n + n / 2) << "from " << n;
+        n = next;
+    }
+}
+
+TYPED_TEST(GrowthPolicyTest, Overflow)
+{
+    constexpr auto max_sz = std::numeric_limits<std::size_t>::max();
+    ASSERT_EQ(this->policy.next(max_sz), max_sz);
+}
+
+template<typename Policy>
+class MapGrowthTest :
+    public testing::Test
+{
+protected:
+
+    using File = unordered_map_file<
+        std::size_t,
+        std::size_t,
+        std::hash<std::size_t>,
+        basic_allocator,
+        Policy>;
+
+    File cont;
+
+};
+
+TYPED_TEST_SUITE(MapGrowthTest, MyPolicies);
+
+TYPED_TEST(MapGrowthTest, PastLastChoice)
+{
+    this->cont.bucket_choices({7});
+    this->cont.rehash(7);
+
+    constexpr std::size_t num = 10000;
+    std::size_t grows = 0, last = this->cont.bucket_count();
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        ASSERT_TRUE(this->cont.emplace(i, i).second);
+
+        if (last != this->cont.bucket_count())
+        {
+            last = this->cont.bucket_count();
+            ++grows;
+        }
+    }
+
+    // growth by one bucket at a time would need thousands
+    ASSERT_LT(grows, 64);
+    ASSERT_EQ(this->cont.size(), num);
+
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        auto iter = this->cont.find(i);
+        ASSERT_NE(iter, this->cont.end()) << "missing " << i;
+        ASSERT_EQ(iter->second, i);
+    }
+}
+
+TYPED_TEST(MapGrowthTest, Reserve)
+{
+    this->cont.bucket_choices({7});
+    this->cont.reserve(100);
+
+    ASSERT_EQ(this->cont.bucket_count(), TypeParam().next(100));
+}
+
+TYPED_TEST(MapGrowthTest, Shrink)
+{
+    this->cont.reserve(1000);
+    for (std::size_t i = 0; i != 200; ++i)
+    {
+        this->cont.emplace(i, i);
+    }
+
+    // never fewer buckets than the elements
+    for (std::size_t buckets : {std::size_t(200), this->cont.bucket_count(), std::size_t(1)})
+    {
+        this->cont.rehash(buckets);
+        ASSERT_GE(this->cont.bucket_count(), 200u);
+        ASSERT_EQ(this->cont.size(), 200u);
+
+        for (std::size_t i = 0; i != 200; ++i)
+        {
+            ASSERT_NE(this->cont.find(i), this->cont.end()) << "missing " << i;
+        }
+    }
+}
+
+TYPED_TEST(MapGrowthTest, MaxLoadFactor)
+{
+    this->cont.max_load_factor(0.5);
+    ASSERT_FLOAT_EQ(this->cont.max_load_factor(), 0.5);
+
+    // ignored, cannot hold more elements than buckets
+    this->cont.max_load_factor(1.5);
+    this->cont.max_load_factor(0);
+    ASSERT_FLOAT_EQ(this->cont.max_load_factor(), 0.5);
+
+    for (std::size_t i = 0; i != 1000; ++i)
+    {
+        this->cont.emplace(i, i);
+        ASSERT_LE(this->cont.load_factor(), 0.5);
+    }
+
+    // lowering must grow right away
+    this->cont.max_load_factor(0.25);
+    ASSERT_LE(this->cont.load_factor(), 0.25);
+
+    for (std::size_t i = 0; i != 1000; ++i)
+    {
+        ASSERT_NE(this->cont.find(i), this->cont.end());
+    }
+}
+
+TEST(MapGrowth, MaxProbe)
+{
+    unordered_map_file<
+        std::size_t,
+        std::size_t,
+        std::hash<std::size_t>,
+        basic_allocator> cont;
+
+    cont.bucket_choices({7});
+    cont.rehash(7);
+    cont.max_probe(2);
+
+    // all keys modded by 7 land at 0, probe gets longer
+    cont.emplace(0, 0);
+    cont.emplace(7, 0);
+    cont.emplace(14, 0);
+    cont.emplace(21, 0);
+    ASSERT_EQ(cont.bucket_count(), 7);
+
+    // the last insert had a probe of 3
+    cont.emplace(28, 0);
+    ASSERT_GT(cont.bucket_count(), 7);
+
+    for (std::size_t i = 0; i != 5; ++i)
+    {
+        ASSERT_NE(cont.find(i * 7), cont.end());
+    }
+}
+
+TEST(MapGrowth, MaxProbeWeakHash)
+{
+    struct Quarter
+    {
+        std::size_t
+        operator()(std::size_t k) const
+        {
+            return k % 4;
+        }
+    };
+
+    unordered_map_file<
+        std::size_t,
+        std::size_t,
+        Quarter,
+        basic_allocator> cont;
+
+    cont.max_probe(4);
+
+    /*  More buckets do not shorten the probes, growing for
+        each long one ran out of memory in a few dozen inserts.
+    */
+    for (std::size_t i = 0; i != 200; ++i)
+    {
+        ASSERT_TRUE(cont.emplace(i, i).second);
+        ASSERT_LT(cont.bucket_count(), 1u << 16) << "at " << i;
+    }
+
+    for (std::size_t i = 0; i != 200; ++i)
+    {
+        ASSERT_NE(cont.find(i), cont.end());
+    }
+}
+
+TEST(Reduce, Range)
+{
+    for (std::size_t i = 0; i != 10000; ++i)
+    {
+        const auto hash = mix_hash(i);
+        ASSERT_LT(modulo_reduce()(hash, 7), 7);
+        ASSERT_LT(mask_reduce<>()(hash, 8), 8);
+        ASSERT_LT(fastrange_reduce<>()(hash, 7), 7);
+        ASSERT_LT(fastrange_reduce<>()(hash, 1), 1);
+    }
+
+    ASSERT_EQ(mul_high(~0ull, ~0ull), ~0ull - 1);
+    ASSERT_EQ(mul_high(1ull << 32, 1ull << 32), 1);
+
+    ASSERT_TRUE(mask_reduce<>().fits(1));
+    ASSERT_TRUE(mask_reduce<>().fits(1024));
+    ASSERT_FALSE(mask_reduce<>().fits(7));
+}
+
+TEST(Reduce, IdentityHashMixed)
+{
+    /*  Without mixing small keys all take the low buckets
+        with a mask, and bucket 0 with fastrange.
+    */
+    std::vector<bool> taken(1024, false);
+    for (std::size_t i = 0; i != 64; ++i)
+    {
+        taken[fastrange_reduce<>()(fastrange_reduce<>().mix(i), 1024)] = true;
+    }
+
+    ASSERT_GT(std::count(taken.begin(), taken.end(), true), 50);
+}
+
+TEST(Wrap, IncrementDecrement)
+{
+    for (std::size_t mod = 1; mod != 20; ++mod)
+    {
+        for (std::size_t i = 0; i != mod; ++i)
+        {
+            auto inc = i, dec = i;
+            increment_wrap(inc, mod);
+            decrement_wrap(dec, mod);
+
+            ASSERT_EQ(inc, (i + 1) % mod);
+            ASSERT_EQ(dec, (i + mod - 1) % mod);
+        }
+    }
+}
+
+TEST(Reduce, OnePassRehash)
+{
+    ASSERT_TRUE(one_pass_rehash<modulo_reduce>::possible(5, 10));
+    ASSERT_FALSE(one_pass_rehash<modulo_reduce>::possible(5, 7));
+    ASSERT_FALSE(one_pass_rehash<modulo_reduce>::possible(10, 5));
+
+    ASSERT_TRUE(one_pass_rehash<mask_reduce<>>::possible(8, 32));
+    ASSERT_FALSE(one_pass_rehash<mask_reduce<>>::possible(32, 8));
+
+    ASSERT_TRUE(one_pass_rehash<fastrange_reduce<>>::possible(100, 37));
+    ASSERT_FALSE(one_pass_rehash<fastrange_reduce<>>::possible(37, 100));
+
+    ASSERT_FALSE(one_pass_rehash<int>::possible(5, 10));
+}
+
+template<typename Cont>
+void
+one_pass_rehash_check(Cont& cont, std::size_t from, std::size_t to, std::size_t step = 13)
+{
+    constexpr std::size_t num = 3000;
+
+    // sizes past the choices are left to the policy
+    cont.bucket_choices({1});
+    cont.rehash(from);
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        cont.emplace(i * step, i);
+    }
+    ASSERT_EQ(cont.bucket_count(), from);
+
+    cont.rehash(to);
+    ASSERT_EQ(cont.bucket_count(), to);
+    ASSERT_EQ(cont.size(), num);
+
+    std::size_t count = 0;
+    for (const auto& kv : cont)
+    {
+        ASSERT_EQ(kv.first, kv.second * step);
+        ++count;
+    }
+    ASSERT_EQ(count, num);
+
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        ASSERT_EQ(cont.find(i * step)->second, i) << "key " << i * step;
+        ASSERT_FALSE(cont.contains(i * step + 1));
+    }
+
+    // erasing shifts back along the order rehashing left
+    for (std::size_t i = 0; i < num; i += 2)
+    {
+        ASSERT_EQ(cont.erase(i * step), 1u);
+    }
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        ASSERT_EQ(cont.contains(i * step), i % 2 == 1) << "key " << i * step;
+    }
+}
+
+TEST(MapGrowth, OnePassSplit)
+{
+    unordered_map_file<
+        std::size_t,
+        std::size_t,
+        std::hash<std::size_t>,
+        basic_allocator,
+        power_of_two_growth_policy<>> cont;
+
+    one_pass_rehash_check(cont, 4096, 16384);
+}
+
+TEST(MapGrowth, OnePassSqueeze)
+{
+    unordered_map_file<
+        std::size_t,
+        std::size_t,
+        std::hash<std::size_t>,
+        basic_allocator,
+        prime_growth_policy<fastrange_reduce<>>> cont;
+
+    // full enough that clusters wrap around the end
+    one_pass_rehash_check(cont, 16381, 4093);
+}
+
+TEST(MapGrowth, OnePassCompact)
+{
+    unordered_map_file<
+        std::size_t,
+        std::size_t,
+        std::hash<std::size_t>,
+        basic_allocator,
+        power_of_two_growth_policy<>,
+        true,
+        compact_layout<>> cont;
+
+    // clusters wrapping around the end are put back last
+    one_pass_rehash_check(cont, 4096, 8192, std::size_t(1) << 20);
+}
+
+TEST(MapGrowth, OnePassNotTrivial)
+{
+    unordered_map_file<
+        std::size_t,
+        std::string,
+        std::hash<std::size_t>,
+        basic_allocator,
+        power_of_two_growth_policy<>> cont;
+
+    constexpr std::size_t num = 3000;
+
+    // moved by elem_move, the one pass only relocates trivial
+    // types, the strings are too long to be kept inline
+    cont.bucket_choices({1});
+    cont.rehash(4096);
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        cont.emplace(i, long_value(i));
+    }
+
+    cont.rehash(16384);
+    ASSERT_EQ(cont.bucket_count(), 16384u);
+    check_long_values(cont, num);
+}
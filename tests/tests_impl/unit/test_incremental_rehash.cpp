@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/unordered_map.h>
+
+using namespace MmapFiles;
+
+using Map = unordered_map_file<std::size_t, std::size_t>;
+
+class IncrementalRehashTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "incremental_rehash_test.dat";
+
+    IncrementalRehashTest()
+    {
+        remove_all();
+    }
+
+    ~IncrementalRehashTest()
+    {
+        remove_all();
+    }
+
+    void
+    remove_all()
+    {
+        std::remove(name.c_str());
+        std::remove((name + ".resize").c_str());
+    }
+
+    bool
+    exists(const std::string& file)
+    {
+        return ::access(file.c_str(), F_OK) == 0;
+    }
+};
+
+TEST_F(IncrementalRehashTest, Steps)
+{
+    Map cont(name, 8, false);
+    ASSERT_EQ(cont.incremental_rehash(), 0u);
+    cont.incremental_rehash(2);
+
+    std::size_t steps = 0;
+    for (std::size_t i = 0; i != 5000; ++i)
+    {
+        cont.emplace(i, i);
+        steps += cont.rehashing();
+    }
+
+    // the growths were spread over several inserts
+    ASSERT_GT(steps, 0u);
+    ASSERT_EQ(cont.size(), 5000u);
+    for (std::size_t i = 0; i != 5000; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i) << "key " << i;
+    }
+}
+
+TEST_F(IncrementalRehashTest, Model)
+{
+    Map cont(name, 8, false);
+    cont.incremental_rehash(1);
+    std::unordered_map<std::size_t, std::size_t> model;
+
+    std::size_t state = 1;
+    for (std::size_t i = 0; i != 20000; ++i)
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const auto key = (state >> 33) % 4000;
+
+        switch ((state >> 20) % 4)
+        {
+        case 0:
+        case 1:
+            ASSERT_EQ(cont.emplace(key, i).second, model.emplace(key, i).second);
+            break;
+        case 2:
+            ASSERT_EQ(cont.erase(key), model.erase(key)) << "key " << key;
+            break;
+        default:
+            const auto iter = cont.find(key);
+            const auto found = model.find(key);
+            ASSERT_EQ(iter == cont.end(), found == model.end()) << "key " << key;
+            if (found != model.end())
+            {
+                ASSERT_EQ(iter->second, found->second);
+            }
+        }
+
+        ASSERT_EQ(cont.size(), model.size());
+    }
+
+    for (const auto& kv : model)
+    {
+        ASSERT_TRUE(static_cast<const Map&>(cont).contains(kv.first));
+    }
+
+    std::size_t count = 0;
+    for (const auto& kv : cont)
+    {
+        ASSERT_EQ(model.at(kv.first), kv.second);
+        ++count;
+    }
+    ASSERT_EQ(count, model.size());
+    ASSERT_FALSE(cont.rehashing());
+}
+
+TEST_F(IncrementalRehashTest, OldIterator)
+{
+    Map cont(name, 8, false);
+    cont.incremental_rehash(1);
+
+    std::size_t i = 0;
+    for (; !cont.rehashing(); ++i)
+    {
+        cont.emplace(i, i);
+    }
+
+    // found in either buckets, erased through the iterator
+    for (std::size_t k = 0; k != i; ++k)
+    {
+        const auto iter = cont.find(k);
+        ASSERT_NE(iter, cont.end());
+        ASSERT_EQ(iter->second, k);
+        iter->second = k + 1;
+    }
+    for (std::size_t k = 0; k != i; k += 2)
+    {
+        cont.erase(cont.find(k));
+    }
+
+    cont.incremental_rehash(0);
+    ASSERT_FALSE(cont.rehashing());
+    for (std::size_t k = 0; k != i; ++k)
+    {
+        ASSERT_EQ(cont.contains(k), k % 2 == 1);
+        if (k % 2)
+        {
+            ASSERT_EQ(cont.find(k)->second, k + 1);
+        }
+    }
+}
+
+TEST_F(IncrementalRehashTest, ConstIterate)
+{
+    Map cont(name, 8, false);
+    cont.incremental_rehash(1);
+
+    std::size_t i = 0;
+    for (; !cont.rehashing(); ++i)
+    {
+        cont.emplace(i, i);
+    }
+
+    // walks both buckets without moving anything
+    const Map& ref = cont;
+    std::vector<bool> seen(i, false);
+    for (auto iter = ref.cbegin(); iter != ref.cend(); ++iter)
+    {
+        ASSERT_LT(iter->first, i);
+        ASSERT_FALSE(seen[iter->first]) << "key " << iter->first;
+        ASSERT_EQ(iter->second, iter->first);
+        seen[iter->first] = true;
+    }
+    ASSERT_EQ(std::count(seen.begin(), seen.end(), true), static_cast<std::ptrdiff_t>(i));
+    ASSERT_TRUE(cont.rehashing());
+
+    std::size_t count = 0;
+    for (auto iter = ref.cend(); iter != ref.cbegin(); ++count)
+    {
+        --iter;
+    }
+    ASSERT_EQ(count, i);
+
+    // from any found key the walk ends at end
+    for (std::size_t k = 0; k != i; ++k)
+    {
+        auto iter = ref.find(k);
+        for (count = 0; iter != ref.cend(); ++iter)
+        {
+            ++count;
+        }
+        ASSERT_GE(count, 1u);
+        ASSERT_LE(count, i);
+    }
+    ASSERT_TRUE(cont.rehashing());
+}
+
+TEST_F(IncrementalRehashTest, EraseLoop)
+{
+    Map cont(name, 8, false);
+    cont.max_load_factor(0.5);
+    cont.incremental_rehash(1);
+
+    std::size_t i = 0;
+    for (; i < 1000 || !cont.rehashing(); ++i)
+    {
+        cont.emplace(i, i);
+    }
+
+    // erase returns the next element, not end, while rehashing
+    std::size_t erased = 0;
+    for (auto iter = static_cast<const Map&>(cont).cbegin(); iter != cont.cend() && cont.rehashing();)
+    {
+        if (iter->first % 2 == 0)
+        {
+            iter = cont.erase(iter);
+            ++erased;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+    ASSERT_GT(erased, 1u);
+
+    cont.incremental_rehash(0);
+    ASSERT_EQ(cont.size(), i - erased);
+    for (std::size_t k = 0; k != i; ++k)
+    {
+        if (k % 2)
+        {
+            ASSERT_TRUE(cont.contains(k)) << "key " << k;
+        }
+    }
+}
+
+TEST_F(IncrementalRehashTest, FindBatch)
+{
+    Map cont(name, 8, false);
+    cont.incremental_rehash(1);
+
+    std::vector<std::size_t> keys;
+    for (std::size_t i = 0; !cont.rehashing(); ++i)
+    {
+        cont.emplace(i, i);
+        keys.push_back(i);
+    }
+
+    // every iterator still points at its key once all are found
+    std::vector<Map::iterator> out(keys.size());
+    cont.find_batch(keys.data(), keys.size(), out.data());
+    for (std::size_t i = 0; i != keys.size(); ++i)
+    {
+        ASSERT_NE(out[i], cont.end());
+        ASSERT_EQ(out[i]->first, keys[i]);
+        ASSERT_EQ(out[i]->second, keys[i]);
+    }
+}
+
+TEST_F(IncrementalRehashTest, Reopen)
+{
+    {
+        Map cont(name, 8, false);
+        cont.incremental_rehash(1);
+        for (std::size_t i = 0; !cont.rehashing(); ++i)
+        {
+            cont.emplace(i, i);
+        }
+        ASSERT_TRUE(exists(name + ".resize"));
+    }
+
+    // the moved buckets took the name of the file
+    ASSERT_FALSE(exists(name + ".resize"));
+
+    Map cont(name, 8, true);
+    ASSERT_GT(cont.size(), 0u);
+    for (std::size_t i = 0; i != cont.size(); ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i);
+    }
+}
+
+TEST(IncrementalRehash, BasicAllocator)
+{
+    unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>, basic_allocator> cont;
+    cont.incremental_rehash(4);
+
+    for (std::size_t i = 0; i != 3000; ++i)
+    {
+        cont.emplace(i, i * 3);
+    }
+    for (std::size_t i = 0; i < 3000; i += 3)
+    {
+        cont.erase(i);
+    }
+
+    ASSERT_EQ(cont.size(), 2000u);
+    for (std::size_t i = 0; i != 3000; ++i)
+    {
+        const auto iter = cont.find(i);
+        ASSERT_EQ(iter == cont.end(), i % 3 == 0);
+    }
+}
@@ -1,7 +1,10 @@
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include <files/bitmap.h>
 #include <files/unordered_map.h>
 #include <tests_support/Vars.h>
 
@@ -81,3 +84,90 @@ TEST_F(MapIteratorTest, Empty)
 {
     ASSERT_EQ(cont.begin(), cont.end());
 }
+
+TEST_F(MapIteratorTest, Sparse)
+{
+    /*  few elements spread over many words of the bitmap,
+        both ends included
+    */
+    cont.bucket_choices({1777});
+    cont.rehash(1777);
+
+    std::vector<std::size_t> keys = { 0, 63, 64, 65, 700, 1776 };
+    for (auto k : keys)
+    {
+        cont.emplace(k, 0);
+    }
+
+    std::vector<std::size_t> seen;
+    for (auto iter = cont.begin(); iter != cont.end(); ++iter)
+    {
+        seen.push_back(iter->first);
+    }
+    ASSERT_EQ(seen, keys);
+
+    seen.clear();
+    for (auto iter = cont.end(); iter != cont.begin();)
+    {
+        --iter;
+        seen.insert(seen.begin(), iter->first);
+    }
+    ASSERT_EQ(seen, keys);
+}
+
+TEST_F(MapIteratorTest, BeginAfterChange)
+{
+    cont.bucket_choices({181});
+    cont.rehash(181);
+
+    cont.emplace(100, 0);
+    cont.emplace(50, 0);
+    ASSERT_EQ(cont.begin()->first, 50);
+
+    cont.erase(50);
+    ASSERT_EQ(cont.begin()->first, 100);
+
+    // taking the last bucket wraps to the first
+    cont.emplace(180, 0);
+    cont.emplace(361, 0);
+    ASSERT_EQ(cont.begin()->first, 361);
+
+    cont.clear();
+    ASSERT_EQ(cont.begin(), cont.end());
+
+    cont.emplace(7, 0);
+    ASSERT_EQ(cont.cbegin()->first, 7);
+}
+
+TEST(Bitmap, NextPrev)
+{
+    using namespace MmapFiles;
+
+    constexpr std::size_t size = 200;
+    std::vector<std::uint64_t> bits(bitmap_words(size), 0);
+
+    ASSERT_EQ(bitmap_next(bits.data(), 0, size), size);
+    ASSERT_EQ(bitmap_prev(bits.data(), size - 1, size), size);
+
+    for (auto i : { 0, 63, 64, 130, 199 })
+    {
+        bitmap_set(bits.data(), i);
+    }
+
+    ASSERT_EQ(bitmap_next(bits.data(), 0, size), 0);
+    ASSERT_EQ(bitmap_next(bits.data(), 1, size), 63);
+    ASSERT_EQ(bitmap_next(bits.data(), 64, size), 64);
+    ASSERT_EQ(bitmap_next(bits.data(), 65, size), 130);
+    ASSERT_EQ(bitmap_next(bits.data(), 131, size), 199);
+    ASSERT_EQ(bitmap_next(bits.data(), 200, size), size);
+
+    ASSERT_EQ(bitmap_prev(bits.data(), 199, size), 199);
+    ASSERT_EQ(bitmap_prev(bits.data(), 198, size), 130);
+    ASSERT_EQ(bitmap_prev(bits.data(), 129, size), 64);
+    ASSERT_EQ(bitmap_prev(bits.data(), 63, size), 63);
+    ASSERT_EQ(bitmap_prev(bits.data(), 62, size), 0);
+
+    bitmap_reset(bits.data(), 0);
+    ASSERT_FALSE(bitmap_test(bits.data(), 0));
+    ASSERT_EQ(bitmap_prev(bits.data(), 62, size), size);
+}
@@ -0,0 +1,268 @@
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/unordered_map.h>
+
+using namespace MmapFiles;
+
+/*  Key which counts every copy made of it, and compares with
+    a plain std::size_t.
+*/
+struct CountedKey
+{
+    static std::size_t copies;
+
+    CountedKey(std::size_t v) :
+        value(v)
+    {
+    }
+
+    CountedKey(const CountedKey& other) :
+        value(other.value)
+    {
+        ++copies;
+    }
+
+    CountedKey(CountedKey&& other) :
+        value(other.value)
+    {
+    }
+
+    std::size_t value;
+};
+
+std::size_t CountedKey::copies = 0;
+
+bool
+operator==(const CountedKey& l, const CountedKey& r)
+{
+    return l.value == r.value;
+}
+
+bool
+operator==(const CountedKey& l, std::size_t r)
+{
+    return l.value == r;
+}
+
+template<bool Transparent>
+struct CountedHash
+{
+    std::size_t
+    operator()(const CountedKey& k) const
+    {
+        return k.value % 7;
+    }
+
+    std::size_t
+    operator()(std::size_t k) const
+    {
+        return k % 7;
+    }
+};
+
+template<>
+struct CountedHash<true> :
+    CountedHash<false>
+{
+    using is_transparent = void;
+};
+
+template<bool Transparent>
+using CountedMap = unordered_map_file<
+    CountedKey,
+    std::size_t,
+    CountedHash<Transparent>,
+    basic_allocator>;
+
+TEST(Transparent, Detect)
+{
+    ASSERT_TRUE(hash_is_transparent<CountedHash<true>>::value);
+    ASSERT_FALSE(hash_is_transparent<CountedHash<false>>::value);
+    ASSERT_FALSE(hash_is_transparent<std::hash<std::string>>::value);
+}
+
+TEST(Transparent, FindNoCopies)
+{
+    CountedMap<false> cont;
+    cont.bucket_choices({31});
+    for (std::size_t i = 0; i != 20; ++i)
+    {
+        cont.emplace(CountedKey(i), i);
+    }
+
+    // long clusters, the probe loop must not copy the key
+    CountedKey::copies = 0;
+    for (std::size_t i = 0; i != 40; ++i)
+    {
+        const CountedKey k(i);
+        ASSERT_EQ(cont.contains(k), i < 20);
+    }
+    ASSERT_EQ(CountedKey::copies, 0);
+}
+
+TEST(Transparent, Lookups)
+{
+    CountedMap<true> cont;
+    cont.bucket_choices({31});
+    for (std::size_t i = 0; i != 20; ++i)
+    {
+        cont.emplace(CountedKey(i), i);
+    }
+
+    CountedKey::copies = 0;
+    for (std::size_t i = 0; i != 40; ++i)
+    {
+        const std::size_t k = i;
+        ASSERT_EQ(cont.contains(k), i < 20);
+        ASSERT_EQ(cont.count(k), i < 20);
+
+        const auto iter = cont.find(k);
+        if (i < 20)
+        {
+            ASSERT_EQ(iter->second, i);
+        }
+        else
+        {
+            ASSERT_EQ(iter, cont.end());
+        }
+    }
+
+    for (std::size_t i = 0; i != 40; i += 2)
+    {
+        ASSERT_EQ(cont.erase(i), i < 20);
+    }
+    ASSERT_EQ(CountedKey::copies, 0);
+
+    ASSERT_EQ(cont.size(), 10);
+    for (std::size_t i = 1; i < 20; i += 2)
+    {
+        ASSERT_TRUE(cont.contains(i));
+    }
+
+    // erase by iterator still picks the iterator overload
+    cont.erase(cont.find(std::size_t(1)));
+    ASSERT_FALSE(cont.contains(std::size_t(1)));
+    ASSERT_EQ(cont.size(), 9);
+}
+
+TEST(TryEmplace, NoMoveWhenExists)
+{
+    unordered_map_file<std::size_t, std::unique_ptr<int>, std::hash<std::size_t>, basic_allocator> cont;
+
+    std::unique_ptr<int> a(new int(1)), b(new int(2));
+    ASSERT_TRUE(cont.try_emplace(7, std::move(a)).second);
+    ASSERT_EQ(a, nullptr);
+
+    const auto res = cont.try_emplace(7, std::move(b));
+    ASSERT_FALSE(res.second);
+    ASSERT_NE(b, nullptr);
+    ASSERT_EQ(*res.first->second, 1);
+
+    // no arguments default constructs the value
+    ASSERT_TRUE(cont.try_emplace(8).second);
+    ASSERT_EQ(cont.find(8)->second, nullptr);
+}
+
+TEST(TryEmplace, KeyCopies)
+{
+    CountedMap<false> cont;
+    cont.bucket_choices({31});
+
+    CountedKey::copies = 0;
+    cont.emplace(CountedKey(1), 1);
+    cont.try_emplace(CountedKey(2), 2);
+    cont[CountedKey(3)] = 3;
+    ASSERT_EQ(CountedKey::copies, 0);
+
+    // copied only into the container, and only when inserted
+    const CountedKey k(4);
+    cont[k] = 4;
+    ASSERT_EQ(CountedKey::copies, 1);
+    cont[k] = 5;
+    cont.try_emplace(k, 6);
+    cont.emplace(k, 7);
+    ASSERT_EQ(CountedKey::copies, 1);
+
+    ASSERT_EQ(cont.find(k)->second, 5);
+    ASSERT_EQ(cont.size(), 4);
+}
+
+TEST(TryEmplace, InsertOrAssign)
+{
+    unordered_map_file<std::size_t, std::string, std::hash<std::size_t>, basic_allocator> cont;
+
+    auto res = cont.insert_or_assign(1, std::string("a"));
+    ASSERT_TRUE(res.second);
+    ASSERT_EQ(res.first->second, "a");
+
+    res = cont.insert_or_assign(1, std::string("b"));
+    ASSERT_FALSE(res.second);
+    ASSERT_EQ(res.first->second, "b");
+    ASSERT_EQ(cont.size(), 1);
+
+    cont[2] += "c";
+    cont[2] += "d";
+    ASSERT_EQ(cont.find(2)->second, "cd");
+}
+
+template<bool Control>
+using BatchMap = unordered_map_file<
+    std::size_t,
+    std::size_t,
+    std::hash<std::size_t>,
+    basic_allocator,
+    prime_growth_policy<>,
+    Control>;
+
+template<typename Map>
+void
+check_batch()
+{
+    Map cont;
+    for (std::size_t i = 0; i != 1000; i += 2)
+    {
+        cont.emplace(i, i * 3);
+    }
+
+    // not a multiple of the chunk size
+    std::vector<std::size_t> keys;
+    for (std::size_t i = 0; i != 997; ++i)
+    {
+        keys.push_back((i * 7919) % 1100);
+    }
+
+    std::vector<typename Map::iterator> found(keys.size());
+    std::unique_ptr<bool[]> contained(new bool[keys.size()]);
+    cont.find_batch(keys.data(), keys.size(), found.data());
+    cont.contains_batch(keys.data(), keys.size(), contained.get());
+
+    const Map& ref = cont;
+    std::vector<typename Map::const_iterator> const_found(keys.size());
+    ref.find_batch(keys.data(), keys.size(), const_found.data());
+
+    for (std::size_t i = 0; i != keys.size(); ++i)
+    {
+        ASSERT_EQ(found[i], cont.find(keys[i]));
+        ASSERT_EQ(const_found[i], ref.find(keys[i]));
+        ASSERT_EQ(contained[i], cont.contains(keys[i]));
+    }
+
+    cont.find_batch(keys.data(), 0, found.data());
+}
+
+TEST(Batch, Find)
+{
+    check_batch<BatchMap<false>>();
+}
+
+TEST(Batch, FindControl)
+{
+    check_batch<BatchMap<true>>();
+}
@@ -0,0 +1,380 @@
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <dirent.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include <files/mmap_allocator.h>
+#include <files/unordered_map.h>
+#include <tests_support/Funcs.h>
+
+using namespace MmapFiles;
+
+class MmapAllocatorTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "mmap_allocator_test.dat";
+
+    MmapAllocatorTest()
+    {
+        std::remove(name.c_str());
+    }
+
+    ~MmapAllocatorTest()
+    {
+        std::remove(name.c_str());
+    }
+};
+
+TEST_F(MmapAllocatorTest, ReservedGrowInPlace)
+{
+    mmap_allocator<std::size_t> alloc(name);
+    alloc.reserve_address(std::size_t(1) << 30);
+
+    auto p = alloc.allocate(100);
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        p[i] = i;
+    }
+
+    // many pages, then back to less than a page
+    for (std::size_t n : {1000, 1000000, 5000, 10})
+    {
+        auto q = alloc.reallocate(p, 100, n);
+        ASSERT_EQ(q, p);
+        for (std::size_t i = 0; i != 10; ++i)
+        {
+            ASSERT_EQ(q[i], i);
+        }
+
+        q[n - 1] = n;
+        ASSERT_EQ(q[n - 1], n);
+        alloc.reallocate(q, n, 100);
+    }
+
+    alloc.deallocate(p, 100);
+}
+
+TEST_F(MmapAllocatorTest, ReservedOutgrow)
+{
+    mmap_allocator<std::size_t> alloc(name);
+    alloc.reserve_address(1 << 16);
+
+    auto p = alloc.allocate(100);
+    p[99] = 99;
+
+    // past the range the mapping moves, the data stays
+    const std::size_t n = (1 << 16) / sizeof(std::size_t) * 4;
+    auto q = alloc.reallocate(p, 100, n);
+    ASSERT_EQ(q[99], 99);
+    q[n - 1] = 1;
+
+    auto r = alloc.reallocate(q, n, 2 * n);
+    ASSERT_EQ(r[99], 99);
+    ASSERT_EQ(r[n - 1], 1);
+
+    alloc.deallocate(r, 2 * n);
+}
+
+TEST_F(MmapAllocatorTest, ReservedMap)
+{
+    unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>, reserved_mmap_allocator> cont(name);
+    ASSERT_EQ(reserved_mmap_allocator<int>().reserved_address(), reserved_mmap_default);
+    compare_with_std(cont, 20000, 50000);
+}
+
+TEST_F(MmapAllocatorTest, HugePageSize)
+{
+    const auto huge = mmap_allocator<char>::huge_page_size();
+    ASSERT_GE(huge, std::size_t(::sysconf(_SC_PAGESIZE)));
+    ASSERT_EQ(huge & (huge - 1), 0u);
+}
+
+TEST_F(MmapAllocatorTest, HugePages)
+{
+    huge_mmap_allocator<std::size_t> alloc(name);
+    ASSERT_EQ(alloc.huge_pages(), huge_page_status::requested);
+
+    const auto huge = alloc.huge_page_size();
+    auto p = alloc.allocate(100);
+    ASSERT_NE(alloc.huge_pages(), huge_page_status::requested);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % huge, 0u);
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        p[i] = i;
+    }
+
+    struct stat st;
+    ASSERT_EQ(::stat(name.c_str(), &st), 0);
+    ASSERT_EQ(std::size_t(st.st_size), huge);
+
+    // moves past the first huge page, still aligned
+    const std::size_t n = huge / sizeof(std::size_t) * 3 + 1;
+    auto q = alloc.reallocate(p, 100, n);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(q) % huge, 0u);
+    ASSERT_EQ(q[99], 99u);
+    q[n - 1] = n;
+
+    ASSERT_EQ(::stat(name.c_str(), &st), 0);
+    ASSERT_EQ(std::size_t(st.st_size), 4 * huge);
+
+    alloc.deallocate(q, n);
+}
+
+TEST_F(MmapAllocatorTest, HugeReserved)
+{
+    huge_mmap_allocator<std::size_t> alloc(name);
+    alloc.reserve_address(std::size_t(1) << 30);
+
+    const auto huge = alloc.huge_page_size();
+    auto p = alloc.allocate(10);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % huge, 0u);
+    p[9] = 9;
+
+    auto q = alloc.reallocate(p, 10, huge);
+    ASSERT_EQ(q, p);
+    ASSERT_EQ(q[9], 9u);
+    q[huge - 1] = 1;
+
+    alloc.deallocate(q, huge);
+}
+
+TEST_F(MmapAllocatorTest, HugeMap)
+{
+    using Map = unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>, huge_mmap_allocator>;
+    {
+        Map cont(name);
+        compare_with_std(cont, 20000, 50000);
+    }
+
+    // the file is larger than the buckets, rounded to huge pages
+    {
+        Map cont(name, 8, false);
+        cont.emplace(3, 3);
+    }
+
+    Map cont(name, 8, true);
+    ASSERT_EQ(cont.size(), 1u);
+    ASSERT_EQ(cont.find(3)->second, 3u);
+}
+
+/*  Nothing is created in the working directory.
+*/
+static std::size_t
+files_here()
+{
+    std::size_t count = 0;
+    if (DIR* dir = ::opendir("."))
+    {
+        while (::readdir(dir))
+        {
+            ++count;
+        }
+        ::closedir(dir);
+    }
+
+    return count;
+}
+
+TEST(AnonymousAllocator, Grow)
+{
+    const auto files = files_here();
+
+    mmap_allocator<std::size_t> alloc;
+    ASSERT_TRUE(alloc.anonymous());
+
+    auto p = alloc.allocate(100);
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        p[i] = i;
+    }
+
+    auto q = alloc.reallocate(p, 100, 1000000);
+    ASSERT_EQ(q[99], 99u);
+    ASSERT_EQ(q[999999], 0u);
+    q[999999] = 1;
+
+    ASSERT_EQ(alloc.file_size(), 0u);
+    ASSERT_EQ(alloc.flush(q, 1000000, true), 0u);
+
+    alloc.clear(q, 1000000);
+    ASSERT_EQ(q[99], 0u);
+    ASSERT_EQ(q[999999], 0u);
+
+    alloc.deallocate(q, 1000000);
+    ASSERT_EQ(files_here(), files);
+}
+
+TEST(AnonymousAllocator, Reserved)
+{
+    mmap_allocator<std::size_t> alloc;
+    alloc.reserve_address(std::size_t(1) << 30);
+
+    // less than a page, the page is kept when growing
+    auto p = alloc.allocate(10);
+    p[9] = 9;
+
+    for (std::size_t n : {1000, 1000000, 5000, 10})
+    {
+        auto q = alloc.reallocate(p, 10, n);
+        ASSERT_EQ(q, p);
+        ASSERT_EQ(q[9], 9u);
+
+        q[n - 1] = n;
+        alloc.reallocate(q, n, 10);
+        ASSERT_EQ(q[9], n == 10 ? 10u : 9u);
+        q[9] = 9;
+    }
+
+    // outgrows the range
+    const std::size_t n = (std::size_t(1) << 30) / sizeof(std::size_t) + 1;
+    auto q = alloc.reallocate(p, 10, n);
+    ASSERT_EQ(q[9], 9u);
+    q[n - 1] = 1;
+
+    alloc.deallocate(q, n);
+}
+
+TEST(AnonymousAllocator, HugePages)
+{
+    huge_mmap_allocator<std::size_t> alloc;
+    ASSERT_TRUE(alloc.anonymous());
+
+    const std::size_t n = alloc.huge_page_size() / sizeof(std::size_t);
+    auto p = alloc.allocate(n);
+    ASSERT_NE(alloc.huge_pages(), huge_page_status::requested);
+    p[n - 1] = 1;
+
+    auto q = alloc.reallocate(p, n, 3 * n);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(q) % alloc.huge_page_size(), 0u);
+    ASSERT_EQ(q[n - 1], 1u);
+    q[3 * n - 1] = 3;
+
+    alloc.deallocate(q, 3 * n);
+}
+
+TEST(AnonymousAllocator, Map)
+{
+    const auto files = files_here();
+    {
+        unordered_map_file<std::size_t, std::size_t> cont;
+        compare_with_std(cont, 20000, 50000);
+
+        cont.clear();
+        ASSERT_EQ(cont.size(), 0u);
+        ASSERT_EQ(cont.begin(), cont.end());
+        cont.emplace(1, 1);
+        ASSERT_EQ(cont.find(1)->second, 1u);
+    }
+
+    ASSERT_EQ(files_here(), files);
+}
+
+TEST_F(MmapAllocatorTest, KeepsDescriptor)
+{
+    const auto moved = name + ".moved";
+
+    mmap_allocator<std::size_t> alloc(name);
+    auto p = alloc.allocate(100);
+    p[0] = 7;
+
+    // growing does not look the path up again
+    ASSERT_EQ(std::rename(name.c_str(), moved.c_str()), 0);
+    auto q = alloc.reallocate(p, 100, 100000);
+    ASSERT_EQ(q[0], 7u);
+    q[99999] = 1;
+
+    struct stat st;
+    ASSERT_NE(::stat(name.c_str(), &st), 0);
+    ASSERT_EQ(::stat(moved.c_str(), &st), 0);
+    ASSERT_GE(std::size_t(st.st_size), 100000 * sizeof(std::size_t));
+
+    alloc.deallocate(q, 100000);
+    std::remove(moved.c_str());
+}
+
+/*  A file size limit stands in for a full disk, growing past it
+    fails with EFBIG as it would with ENOSPC.
+*/
+class FileLimit
+{
+public:
+
+    explicit FileLimit(rlim_t bytes)
+    {
+        ::getrlimit(RLIMIT_FSIZE, &M_old);
+        M_handler = std::signal(SIGXFSZ, SIG_IGN);
+
+        rlimit limit = M_old;
+        limit.rlim_cur = bytes;
+        ::setrlimit(RLIMIT_FSIZE, &limit);
+    }
+
+    ~FileLimit()
+    {
+        ::setrlimit(RLIMIT_FSIZE, &M_old);
+        std::signal(SIGXFSZ, M_handler);
+    }
+
+private:
+
+    rlimit M_old;
+    void (*M_handler)(int);
+};
+
+TEST_F(MmapAllocatorTest, FileFull)
+{
+    mmap_allocator<std::size_t> alloc(name);
+    auto p = alloc.allocate(100);
+    p[99] = 99;
+
+    {
+        FileLimit limit(1 << 20);
+        auto q = alloc.reallocate(p, 100, 1 << 20);
+        ASSERT_EQ(static_cast<void*>(q), MAP_FAILED);
+    }
+
+    // the old memory and file are untouched
+    ASSERT_EQ(p[99], 99u);
+    ASSERT_EQ(alloc.file_size(), 100u);
+
+    auto q = alloc.reallocate(p, 100, 1 << 20);
+    ASSERT_NE(static_cast<void*>(q), MAP_FAILED);
+    ASSERT_EQ(q[99], 99u);
+    alloc.deallocate(q, 1 << 20);
+}
+
+TEST_F(MmapAllocatorTest, MapFull)
+{
+    unordered_map_file<std::size_t, std::size_t> cont(name, 8, false);
+
+    std::size_t inserted = 0;
+    {
+        FileLimit limit(1 << 20);
+        while (cont.emplace(inserted, inserted).second)
+        {
+            ++inserted;
+        }
+    }
+
+    // filled what it had, then stopped cleanly
+    ASSERT_GT(inserted, 0u);
+    ASSERT_EQ(cont.size(), inserted);
+    ASSERT_EQ(cont.size(), cont.bucket_count());
+    ASSERT_LE(cont.bucket_count() * 2 * sizeof(std::size_t), std::size_t(1) << 20);
+    for (std::size_t i = 0; i != inserted; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i);
+    }
+
+    ASSERT_TRUE(cont.emplace(inserted, inserted).second);
+    ASSERT_GT(cont.bucket_count(), inserted);
+}
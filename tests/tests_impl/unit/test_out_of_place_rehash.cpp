@@ -0,0 +1,262 @@
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/slot_layout.h>
+#include <files/unordered_map.h>
+#include <tests_support/Funcs.h>
+
+using namespace MmapFiles;
+
+using Map = unordered_map_file<std::size_t, std::size_t>;
+
+class OutOfPlaceRehashTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "out_of_place_rehash_test.dat";
+
+    OutOfPlaceRehashTest()
+    {
+        remove_all();
+    }
+
+    ~OutOfPlaceRehashTest()
+    {
+        remove_all();
+    }
+
+    void
+    remove_all()
+    {
+        std::remove(name.c_str());
+        std::remove((name + ".resize").c_str());
+    }
+
+    ino_t
+    inode()
+    {
+        struct stat st;
+        return ::stat(name.c_str(), &st) ? 0 : st.st_ino;
+    }
+};
+
+TEST_F(OutOfPlaceRehashTest, Grow)
+{
+    {
+        Map cont(name, 8, false);
+        ASSERT_FALSE(cont.out_of_place_rehash());
+        cont.out_of_place_rehash(true);
+
+        for (std::size_t i = 0; i != 5000; ++i)
+        {
+            cont.emplace(i, i * 2);
+        }
+
+        for (std::size_t i = 0; i != 5000; ++i)
+        {
+            ASSERT_EQ(cont.find(i)->second, i * 2) << "key " << i;
+        }
+        ASSERT_EQ(::access((name + ".resize").c_str(), F_OK), -1);
+    }
+
+    Map cont(name, 8, true);
+    ASSERT_EQ(cont.size(), 5000u);
+    for (std::size_t i = 0; i != 5000; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i * 2);
+    }
+}
+
+TEST_F(OutOfPlaceRehashTest, RenamedOver)
+{
+    Map cont(name, 8, false);
+    cont.out_of_place_rehash(true);
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        cont.emplace(i, i);
+    }
+
+    // the name moves to a new file, the old stays open for readers
+    const auto before = inode();
+    FILE*      reader = std::fopen(name.c_str(), "rb");
+    ASSERT_NE(reader, nullptr);
+
+    const auto stats = cont.flushed();
+    cont.rehash(cont.bucket_count() * 4);
+    ASSERT_NE(inode(), before);
+    ASSERT_GT(cont.flushed().flushes, stats.flushes);
+
+    struct stat st;
+    ASSERT_EQ(::fstat(::fileno(reader), &st), 0);
+    ASSERT_EQ(st.st_ino, before);
+    std::fclose(reader);
+
+    // shrinking copies too
+    cont.rehash(100);
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i);
+    }
+}
+
+TEST_F(OutOfPlaceRehashTest, LeftOver)
+{
+    // a copy a crash left behind is written over
+    {
+        FILE* junk = std::fopen((name + ".resize").c_str(), "wb");
+        for (int i = 0; i != 1 << 16; ++i)
+        {
+            std::fputc(0x5a, junk);
+        }
+        std::fclose(junk);
+    }
+
+    unordered_map_file<
+        std::size_t, std::size_t,
+        std::hash<std::size_t>,
+        mmap_allocator,
+        prime_growth_policy<>,
+        false,
+        full_hash_layout> cont(name, 8, false);
+    cont.out_of_place_rehash(true);
+
+    for (std::size_t i = 0; i != 2000; ++i)
+    {
+        cont.emplace(i, i);
+    }
+    ASSERT_EQ(cont.size(), 2000u);
+
+    std::size_t count = 0;
+    for (const auto& kv : cont)
+    {
+        ASSERT_EQ(kv.first, kv.second);
+        ++count;
+    }
+    ASSERT_EQ(count, 2000u);
+}
+
+TEST(OutOfPlaceRehash, BasicAllocator)
+{
+    unordered_map_file<
+        std::size_t, std::size_t,
+        std::hash<std::size_t>,
+        basic_allocator,
+        prime_growth_policy<>,
+        false,
+        compact_layout<>> cont;
+    cont.out_of_place_rehash(true);
+
+    for (std::size_t i = 0; i != 3000; ++i)
+    {
+        cont.emplace(i, i);
+    }
+    for (std::size_t i = 0; i < 3000; i += 2)
+    {
+        cont.erase(i);
+    }
+
+    cont.rehash(0);
+    ASSERT_EQ(cont.size(), 1500u);
+    for (std::size_t i = 0; i != 3000; ++i)
+    {
+        ASSERT_EQ(cont.contains(i), i % 2 == 1);
+    }
+}
+
+TEST(OutOfPlaceRehash, NotTrivial)
+{
+    // std::string is not copied as bytes, it is moved in place
+    unordered_map_file<
+        std::size_t, std::string,
+        std::hash<std::size_t>,
+        basic_allocator> cont;
+    cont.out_of_place_rehash(true);
+
+    for (std::size_t i = 0; i != 3000; ++i)
+    {
+        cont.emplace(i, long_value(i));
+    }
+
+    cont.rehash(cont.bucket_count() * 4);
+    check_long_values(cont, 3000);
+
+    // and on the calling thread alone
+    cont.rehash(cont.bucket_count() * 4, 4);
+    check_long_values(cont, 3000);
+}
+
+TEST_F(OutOfPlaceRehashTest, Parallel)
+{
+    constexpr std::size_t num = 200000;
+
+    Map cont(name, 8, false);
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        cont.emplace(i, i + 1);
+    }
+
+    cont.rehash(num * 3, 4);
+    ASSERT_GE(cont.bucket_count(), num * 3);
+    ASSERT_EQ(::access((name + ".resize").c_str(), F_OK), -1);
+
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i + 1) << "key " << i;
+    }
+
+    // more threads than buckets, and shrinking
+    cont.clear();
+    for (std::size_t i = 0; i != 10; ++i)
+    {
+        cont.emplace(i, i + 1);
+    }
+    cont.rehash(0, 64);
+    ASSERT_EQ(cont.size(), 10u);
+    for (std::size_t i = 0; i != 10; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i + 1);
+    }
+}
+
+TEST(OutOfPlaceRehash, ParallelClusters)
+{
+    // every key in a few buckets, clusters cross every share
+    struct Clustered
+    {
+        std::size_t
+        operator()(std::size_t k) const
+        {
+            return k % 7;
+        }
+    };
+
+    unordered_map_file<
+        std::size_t, std::size_t,
+        Clustered,
+        basic_allocator,
+        prime_growth_policy<>,
+        false,
+        compact_layout<>> cont;
+
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        cont.emplace(i, i);
+    }
+    cont.rehash(400, 8);
+
+    for (std::size_t i = 0; i < 100; i += 3)
+    {
+        ASSERT_EQ(cont.erase(i), 1u);
+    }
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        ASSERT_EQ(cont.contains(i), i % 3 != 0) << "key " << i;
+    }
+}
@@ -0,0 +1,166 @@
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/sharded_map.h>
+#include <files/spin_lock.h>
+
+using namespace MmapFiles;
+
+using Map = sharded_map_file<std::size_t, std::size_t, std::hash<std::size_t>, 4>;
+
+class ShardedMapTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "sharded_map_test.dat";
+
+    ShardedMapTest()
+    {
+        remove_all();
+    }
+
+    ~ShardedMapTest()
+    {
+        remove_all();
+    }
+
+    void
+    remove_all()
+    {
+        for (std::size_t s = 0; s != Map::shards; ++s)
+        {
+            std::remove(Map::shard_name(name, s).c_str());
+        }
+    }
+};
+
+TEST(ShardedMap, Route)
+{
+    // identity hash of small keys still spreads over the shards
+    std::vector<std::size_t> count(Map::shards);
+    for (std::size_t i = 0; i != 4000; ++i)
+    {
+        ++count[Map::shard_of_hash(i)];
+    }
+
+    for (auto n : count)
+    {
+        ASSERT_GT(n, 800u);
+    }
+}
+
+TEST_F(ShardedMapTest, Files)
+{
+    {
+        Map cont(name, 1024, false);
+        for (std::size_t i = 0; i != 1000; ++i)
+        {
+            ASSERT_TRUE(cont.emplace(i, i * 2));
+        }
+        ASSERT_FALSE(cont.emplace(5, 0));
+        ASSERT_FALSE(cont.insert_or_assign(5, 11));
+        ASSERT_EQ(cont.erase(6), 1u);
+        ASSERT_EQ(cont.size(), 999u);
+    }
+
+    // every shard in a file of its own
+    for (std::size_t s = 0; s != Map::shards; ++s)
+    {
+        auto file = std::fopen(Map::shard_name(name, s).c_str(), "r");
+        ASSERT_NE(file, nullptr);
+        std::fclose(file);
+    }
+
+    Map cont(name, 8, true);
+    ASSERT_EQ(cont.size(), 999u);
+
+    std::size_t v = 0;
+    ASSERT_TRUE(cont.find(5, v));
+    ASSERT_EQ(v, 11u);
+    ASSERT_FALSE(cont.find(6, v));
+    ASSERT_TRUE(cont.visit(7, [](std::size_t& x){ x = 70; }));
+    ASSERT_TRUE(cont.find(7, v));
+    ASSERT_EQ(v, 70u);
+}
+
+TEST(ShardedMap, Batch)
+{
+    sharded_map_file<
+        std::size_t, std::size_t,
+        std::hash<std::size_t>,
+        8,
+        basic_allocator,
+        spin_lock<backoff_none>> cont;
+
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    for (std::size_t i = 0; i != 1000; ++i)
+    {
+        pairs.emplace_back(i * 2, i);
+    }
+    ASSERT_EQ(cont.insert_batch(pairs.data(), pairs.size()), 1000u);
+    ASSERT_EQ(cont.insert_batch(pairs.data(), 10), 0u);
+
+    std::vector<std::size_t> keys;
+    for (std::size_t i = 0; i != 2000; ++i)
+    {
+        keys.push_back(i);
+    }
+
+    std::unique_ptr<bool[]> found(new bool[keys.size()]);
+    cont.contains_batch(keys.data(), keys.size(), found.get());
+    for (std::size_t i = 0; i != keys.size(); ++i)
+    {
+        ASSERT_EQ(found[i], i % 2 == 0) << "key " << i;
+    }
+
+    ASSERT_EQ(cont.erase_batch(keys.data(), 100), 50u);
+    ASSERT_EQ(cont.size(), 950u);
+}
+
+TEST_F(ShardedMapTest, Writers)
+{
+    const std::size_t threads = 4;
+    const std::size_t each    = 50000;
+
+    Map cont(name);
+
+    std::vector<std::thread> writers;
+    for (std::size_t t = 0; t != threads; ++t)
+    {
+        writers.emplace_back([&, t]()
+        {
+            std::vector<std::pair<std::size_t, std::size_t>> pairs;
+            for (std::size_t i = 0; i != each; ++i)
+            {
+                const auto k = i * threads + t;
+                pairs.emplace_back(k, k + 1);
+                if (pairs.size() == 1000)
+                {
+                    cont.insert_batch(pairs.data(), pairs.size());
+                    pairs.clear();
+                }
+            }
+        });
+    }
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+
+    ASSERT_EQ(cont.size(), threads * each);
+    for (std::size_t k = 0; k != threads * each; ++k)
+    {
+        std::size_t v = 0;
+        ASSERT_TRUE(cont.find(k, v)) << "key " << k;
+        ASSERT_EQ(v, k + 1);
+    }
+}
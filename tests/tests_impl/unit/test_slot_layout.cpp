@@ -0,0 +1,266 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/basic_allocator.h>
+#include <files/slot_layout.h>
+#include <files/unordered_map.h>
+#include <tests_support/CustomString.h>
+#include <tests_support/Funcs.h>
+
+using namespace MmapFiles;
+
+TEST(SlotLayout, Size)
+{
+    using full    = full_hash_layout::element<int, int>;
+    using compact = compact_layout<>::element<int, int>;
+    using wide    = compact_layout<std::uint64_t>::element<int, int>;
+
+    ASSERT_EQ(sizeof(full), 2 * sizeof(std::size_t) + 2 * sizeof(int));
+    ASSERT_EQ(sizeof(compact), 4 + 2 * sizeof(int));
+    ASSERT_EQ(sizeof(wide), 8 + 2 * sizeof(int));
+
+    using sentinel = sentinel_layout<std::uint64_t>::element<std::uint64_t, std::uint64_t>;
+    ASSERT_EQ(sizeof(sentinel), 16);
+
+    /*  A 32 bit word is widened so 64 bit keys stay aligned in
+        aligned buckets.
+    */
+    using padded = compact_layout<>::element<std::uint64_t, std::uint64_t>;
+    ASSERT_EQ(sizeof(padded), 24);
+
+    padded e;
+    const auto offset = reinterpret_cast<const char*>(&get<1>(e)) - reinterpret_cast<const char*>(&e);
+    ASSERT_EQ(offset % alignof(std::pair<const std::uint64_t, std::uint64_t>), 0);
+}
+
+TEST(SlotLayout, CompactHeader)
+{
+    using layout  = compact_layout<>;
+    using element = layout::element<int, int>;
+
+    element e;
+    layout::set_free(e);
+    ASSERT_TRUE(layout::is_free(e));
+
+    const std::size_t hash = 0x123456789abcdefull;
+    layout::construct(&e, hash, 5, 1, 2);
+    ASSERT_FALSE(layout::is_free(e));
+    ASSERT_TRUE(layout::matches(e, hash));
+    ASSERT_FALSE(layout::matches(e, hash + 1));
+
+    // displacement of 5 at index 2 of 7 wraps to home 4
+    ASSERT_EQ(layout::home(e, 2, 7, modulo_reduce(), std::hash<int>()), 4);
+
+    // one forward then one back
+    layout::moved(e, 3, 2, 7);
+    ASSERT_EQ(layout::home(e, 3, 7, modulo_reduce(), std::hash<int>()), 4);
+    layout::moved(e, 2, 3, 7);
+    ASSERT_EQ(layout::home(e, 2, 7, modulo_reduce(), std::hash<int>()), 4);
+
+    // forward with wrap around
+    layout::set_home(e, 6, 4, 7);
+    layout::moved(e, 0, 6, 7);
+    ASSERT_EQ(layout::home(e, 0, 7, modulo_reduce(), std::hash<int>()), 4);
+
+    layout::set_home(e, 3, 3, 7);
+    ASSERT_EQ(layout::home(e, 3, 7, modulo_reduce(), std::hash<int>()), 3);
+    ASSERT_TRUE(layout::matches(e, hash));
+
+    layout::set_free(e);
+    ASSERT_TRUE(layout::is_free(e));
+}
+
+struct CollideHash
+{
+    std::size_t
+    operator()(std::size_t k) const
+    {
+        return k % 5;
+    }
+};
+
+template<typename Layout, typename Hash = std::hash<std::size_t>, bool Control = false>
+using LayoutMap = unordered_map_file<
+    std::size_t,
+    std::size_t,
+    Hash,
+    basic_allocator,
+    prime_growth_policy<>,
+    Control,
+    Layout>;
+
+TEST(CompactMap, CollidingDifferential)
+{
+    LayoutMap<compact_layout<>, CollideHash> cont;
+    cont.bucket_choices({7, 13, 31, 61, 127});
+    compare_with_std(cont, 100, 20000);
+}
+
+TEST(CompactMap, Differential)
+{
+    LayoutMap<compact_layout<std::uint64_t>> cont;
+    compare_with_std(cont, 5000, 50000);
+}
+
+TEST(CompactMap, ControlDifferential)
+{
+    LayoutMap<compact_layout<>, CollideHash, true> cont;
+    compare_with_std(cont, 100, 20000);
+}
+
+TEST(CompactMap, Shrink)
+{
+    LayoutMap<compact_layout<>> cont;
+    for (std::size_t i = 0; i != 1000; ++i)
+    {
+        cont.emplace(i, i);
+    }
+    for (std::size_t i = 0; i != 900; ++i)
+    {
+        cont.erase(i);
+    }
+
+    const auto before = cont.bucket_count();
+    cont.rehash(0);
+    ASSERT_LT(cont.bucket_count(), before);
+
+    for (std::size_t i = 900; i != 1000; ++i)
+    {
+        ASSERT_EQ(cont.find(i)->second, i);
+    }
+}
+
+TEST(CompactMap, SharedHashOverflow)
+{
+    using Key  = MyString<16>;
+    using Cont = unordered_map_file<Key, int, collison<16, 7>, basic_allocator,
+                                    prime_growth_policy<>, false, compact_layout<>>;
+
+    const auto most = compact_layout<>::max_displacement + 1;
+    std::vector<std::pair<Key, int>> pairs;
+    for (std::size_t i = 0; i != most + 1; ++i)
+    {
+        pairs.emplace_back(std::to_string(i).c_str(), static_cast<int>(i));
+    }
+
+    // growing does not shorten the run, throws rather than growing forever
+    Cont cont;
+    ASSERT_EQ(cont.bulk_load(pairs.begin(), pairs.end() - 1), most);
+    ASSERT_THROW(cont.emplace(pairs[most].first, pairs[most].second), std::length_error);
+    ASSERT_EQ(cont.size(), most);
+    for (std::size_t i = 0; i < most; i += 1000)
+    {
+        ASSERT_EQ(cont.find(pairs[i].first)->second, static_cast<int>(i));
+    }
+
+    Cont loaded;
+    ASSERT_THROW(loaded.bulk_load(pairs.begin(), pairs.end()), std::length_error);
+    ASSERT_EQ(loaded.size(), 0u);
+}
+
+TEST(SentinelMap, CollidingDifferential)
+{
+    LayoutMap<sentinel_layout<std::size_t>, CollideHash> cont;
+    cont.bucket_choices({7, 13, 31, 61, 127});
+    compare_with_std(cont, 100, 20000);
+}
+
+TEST(SentinelMap, SentinelKey)
+{
+    constexpr auto sentinel = std::numeric_limits<std::size_t>::max();
+
+    LayoutMap<sentinel_layout<std::size_t>> cont;
+    ASSERT_THROW(cont.emplace(sentinel, 1), std::invalid_argument);
+    ASSERT_THROW(cont.try_emplace(sentinel, 1), std::invalid_argument);
+    ASSERT_THROW(cont.insert_or_assign(sentinel, 1), std::invalid_argument);
+    ASSERT_THROW(cont[sentinel], std::invalid_argument);
+    ASSERT_EQ(cont.size(), 0);
+    ASSERT_EQ(cont.find(sentinel), cont.end());
+
+    ASSERT_TRUE(cont.emplace(sentinel - 1, 1).second);
+    ASSERT_EQ(cont.find(sentinel), cont.end());
+    ASSERT_EQ(cont.find(sentinel - 1)->second, 1);
+}
+
+TEST(SlotLayout, ZeroIsFree)
+{
+    ASSERT_TRUE(bool(full_hash_layout::zero_is_free));
+    ASSERT_TRUE(bool(compact_layout<>::zero_is_free));
+    ASSERT_FALSE(bool(sentinel_layout<int>::zero_is_free));
+    ASSERT_TRUE(bool(sentinel_layout<int, 0>::zero_is_free));
+
+    full_hash_layout::element<int, int> full;
+    std::memset(static_cast<void*>(&full), 0, sizeof(full));
+    ASSERT_TRUE(full_hash_layout::is_free(full));
+
+    compact_layout<>::element<int, int> compact;
+    std::memset(static_cast<void*>(&compact), 0, sizeof(compact));
+    ASSERT_TRUE(compact_layout<>::is_free(compact));
+}
+
+TEST(SentinelMap, ZeroSentinel)
+{
+    LayoutMap<sentinel_layout<std::size_t, 0>, CollideHash> cont;
+    ASSERT_THROW(cont.emplace(0, 1), std::invalid_argument);
+
+    for (std::size_t i = 1; i != 1000; ++i)
+    {
+        ASSERT_TRUE(cont.emplace(i, i).second);
+    }
+    for (std::size_t i = 1; i < 1000; i += 2)
+    {
+        ASSERT_EQ(cont.erase(i), 1);
+    }
+    for (std::size_t i = 1; i != 1000; ++i)
+    {
+        ASSERT_EQ(cont.contains(i), i % 2 == 0) << "key " << i;
+    }
+
+    cont.clear();
+    ASSERT_EQ(cont.begin(), cont.end());
+    ASSERT_TRUE(cont.emplace(3, 3).second);
+    ASSERT_EQ(cont.find(3)->second, 3);
+}
+
+TEST(ZeroIsFree, MmapClear)
+{
+    // large enough that whole pages are removed from the file
+    unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>,
+                       mmap_allocator, prime_growth_policy<>, false, full_hash_layout> cont(10000);
+    destruct_is_wipe(cont, true);
+
+    for (std::size_t i = 0; i != 5000; ++i)
+    {
+        cont.emplace(i, i);
+    }
+
+    cont.clear();
+    ASSERT_EQ(cont.size(), 0);
+    ASSERT_EQ(cont.begin(), cont.end());
+    ASSERT_EQ(cont.find(10), cont.end());
+
+    for (std::size_t i = 0; i != 5000; ++i)
+    {
+        ASSERT_TRUE(cont.emplace(i, i + 1).second);
+    }
+    ASSERT_EQ(std::distance(cont.begin(), cont.end()), 5000);
+    ASSERT_EQ(cont.find(10)->second, 11);
+}
+
+TEST(ZeroIsFree, MmapGrow)
+{
+    unordered_map_file<std::size_t, std::size_t, std::hash<std::size_t>,
+                       mmap_allocator, prime_growth_policy<>, true, compact_layout<>> cont;
+    destruct_is_wipe(cont, true);
+    compare_with_std(cont, 5000, 20000);
+}
@@ -73,7 +73,11 @@ using MyTypes = testing::Types
     typename test_file_type<FAST_TESTS, MyString<156>, long>::file,
     typename test_file_type<FAST_TESTS, MyString<67>, short, collison<67, 0>>::file,
     typename test_file_type<FAST_TESTS, MyString<953>, long, collison<953, std::numeric_limits<std::size_t>::max()>>::file,
-    typename test_file_type<FAST_TESTS, std::string, long>::file
+    typename test_file_type<FAST_TESTS, std::string, long>::file,
+    MmapFiles::unordered_map_file<
+        MyString<67>, short, collison<67, 0>,
+        MmapFiles::basic_allocator, MmapFiles::prime_growth_policy<>, false,
+        MmapFiles::compact_layout<>>
 >;
 TYPED_TEST_SUITE(UnorderedMapReqTest, MyTypes);
 
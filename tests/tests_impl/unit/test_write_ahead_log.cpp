@@ -0,0 +1,450 @@
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <files/unordered_map.h>
+#include <files/write_ahead_log.h>
+
+using namespace MmapFiles;
+
+using Map = unordered_map_file<std::size_t, std::size_t>;
+
+class WriteAheadLogTest :
+    public testing::Test
+{
+public:
+
+    const std::string name = "wal_test.dat";
+
+    WriteAheadLogTest()
+    {
+        remove_all();
+    }
+
+    ~WriteAheadLogTest()
+    {
+        remove_all();
+    }
+
+    void
+    remove_all()
+    {
+        for (auto suffix : {"", ".wal", ".ckpt", ".ckpt.tmp"})
+        {
+            std::remove((name + suffix).c_str());
+        }
+    }
+
+    bool
+    exists(const std::string& file)
+    {
+        return ::access(file.c_str(), F_OK) == 0;
+    }
+};
+
+TEST_F(WriteAheadLogTest, Replay)
+{
+    {
+        write_ahead_log log(name);
+        ASSERT_TRUE(log.is_open());
+
+        for (std::uint64_t i = 0; i != 10; ++i)
+        {
+            const std::uint64_t value = i * 2;
+            log.append(wal_op::insert, &i, sizeof(i), &value, sizeof(value));
+        }
+        log.append(wal_op::clear, nullptr, 0, nullptr, 0);
+        ASSERT_TRUE(log.commit());
+    }
+
+    // a record torn by a crash
+    {
+        const int fd = ::open(name.c_str(), O_WRONLY | O_APPEND);
+        const char torn[20] = { 8 };
+        ASSERT_EQ(::write(fd, torn, sizeof(torn)), 20);
+        ::close(fd);
+    }
+
+    write_ahead_log log(name);
+    std::vector<std::uint64_t> keys;
+    const auto count = log.replay([&](wal_op op, const char* payload, std::size_t size)
+    {
+        if (op == wal_op::insert)
+        {
+            ASSERT_EQ(size, 16u);
+            std::uint64_t key, value;
+            std::memcpy(&key, payload, 8);
+            std::memcpy(&value, payload + 8, 8);
+            ASSERT_EQ(value, key * 2);
+            keys.push_back(key);
+        }
+        else
+        {
+            ASSERT_EQ(op, wal_op::clear);
+            ASSERT_EQ(size, 0u);
+        }
+    });
+
+    ASSERT_EQ(count, 11u);
+    ASSERT_EQ(keys.size(), 10u);
+    ASSERT_EQ(keys[9], 9u);
+
+    ASSERT_TRUE(log.truncate());
+    ASSERT_EQ(log.replay([](wal_op, const char*, std::size_t){}), 0u);
+}
+
+TEST_F(WriteAheadLogTest, GroupCommit)
+{
+    write_ahead_log log(name);
+
+    std::vector<std::thread> threads;
+    for (std::uint64_t t = 0; t != 8; ++t)
+    {
+        threads.emplace_back([&log, t]
+        {
+            for (std::uint64_t i = 0; i != 100; ++i)
+            {
+                const auto key = t * 100 + i;
+                ASSERT_TRUE(log.commit(log.append(wal_op::erase, &key, sizeof(key), nullptr, 0)));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_GE(log.commits(), 1u);
+    ASSERT_LE(log.commits(), 800u);
+    ASSERT_EQ(log.replay([](wal_op, const char*, std::size_t){}), 800u);
+}
+
+TEST_F(WriteAheadLogTest, FailedCommit)
+{
+    const pid_t pid = ::fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        write_ahead_log log(name);
+        for (std::uint64_t i = 0; i != 10; ++i)
+        {
+            log.append(wal_op::erase, &i, sizeof(i), nullptr, 0);
+        }
+        const bool first = log.commit();
+
+        // the next write is cut short, as by a full disk
+        ::signal(SIGXFSZ, SIG_IGN);
+        struct rlimit limit;
+        ::getrlimit(RLIMIT_FSIZE, &limit);
+        const auto old = limit.rlim_cur;
+        limit.rlim_cur = 300;
+        ::setrlimit(RLIMIT_FSIZE, &limit);
+
+        for (std::uint64_t i = 10; i != 20; ++i)
+        {
+            log.append(wal_op::erase, &i, sizeof(i), nullptr, 0);
+        }
+        const bool failed = !log.commit();
+
+        struct stat st;
+        ::stat(name.c_str(), &st);
+        const bool cut = st.st_size == 240;
+
+        limit.rlim_cur = old;
+        ::setrlimit(RLIMIT_FSIZE, &limit);
+        const bool second = log.commit();
+
+        ::_exit(first && failed && cut && second ? 0 : 1);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    write_ahead_log log(name);
+    std::uint64_t next = 0;
+    ASSERT_EQ(log.replay([&](wal_op, const char* payload, std::size_t)
+    {
+        std::uint64_t key;
+        std::memcpy(&key, payload, 8);
+        ASSERT_EQ(key, next++);
+    }), 20u);
+}
+
+TEST_F(WriteAheadLogTest, Groups)
+{
+    Map cont(name, 8, false, write_ahead{10});
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        cont.emplace(i, i);
+    }
+    ASSERT_EQ(cont.wal_commits(), 10u);
+
+    cont.emplace(100, 100);
+    ASSERT_TRUE(cont.commit());
+    ASSERT_EQ(cont.wal_commits(), 11u);
+}
+
+TEST_F(WriteAheadLogTest, CleanClose)
+{
+    {
+        Map cont(name, 8, false, write_ahead{1});
+        cont.emplace(1, 1);
+        ASSERT_TRUE(exists(name + ".wal"));
+        ASSERT_TRUE(exists(name + ".ckpt"));
+    }
+    ASSERT_TRUE(exists(name + ".wal"));
+    ASSERT_TRUE(exists(name + ".ckpt"));
+
+    struct stat before;
+    ASSERT_EQ(::stat((name + ".ckpt").c_str(), &before), 0);
+
+    Map cont(name, 8, true, write_ahead{1});
+    ASSERT_EQ(cont.size(), 1u);
+    ASSERT_EQ(cont.find(1)->second, 1u);
+
+    // reopening keeps the checkpoint rather than copying the file
+    struct stat after;
+    ASSERT_EQ(::stat((name + ".ckpt").c_str(), &after), 0);
+    ASSERT_EQ(before.st_ino, after.st_ino);
+}
+
+TEST_F(WriteAheadLogTest, Crash)
+{
+    const pid_t pid = ::fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        Map cont(name, 8, false, write_ahead{1});
+        for (std::size_t i = 0; i != 1000; ++i)
+        {
+            cont.emplace(i, i);
+        }
+
+        cont.checkpoint();
+
+        for (std::size_t i = 0; i < 1000; i += 2)
+        {
+            cont.erase(i);
+        }
+        for (std::size_t i = 1; i < 1000; i += 4)
+        {
+            cont.insert_or_assign(i, i + 1);
+        }
+
+        // the file is left torn, only the log is to be trusted
+        const int fd = ::open(name.c_str(), O_WRONLY);
+        const std::vector<char> junk(1 << 16, 0x5a);
+        ::pwrite(fd, junk.data(), junk.size(), 4096);
+        ::close(fd);
+
+        ::_exit(0);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+
+    Map cont(name, 8, true, write_ahead{1});
+    ASSERT_EQ(cont.size(), 500u);
+    for (std::size_t i = 0; i != 1000; ++i)
+    {
+        const auto iter = cont.find(i);
+        if (i % 2 == 0)
+        {
+            ASSERT_EQ(iter, cont.end()) << "key " << i;
+        }
+        else
+        {
+            ASSERT_NE(iter, cont.end()) << "key " << i;
+            ASSERT_EQ(iter->second, i % 4 == 1 ? i + 1 : i);
+        }
+    }
+}
+
+TEST_F(WriteAheadLogTest, CrashAfterReopen)
+{
+    {
+        Map cont(name, 8, false, write_ahead{1});
+        for (std::size_t i = 0; i != 100; ++i)
+        {
+            cont.emplace(i, i);
+        }
+    }
+
+    const pid_t pid = ::fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        Map cont(name, 8, true, write_ahead{1});
+        for (std::size_t i = 100; i != 200; ++i)
+        {
+            cont.emplace(i, i);
+        }
+        cont.erase(0);
+
+        const int fd = ::open(name.c_str(), O_WRONLY);
+        const std::vector<char> junk(1 << 16, 0x5a);
+        ::pwrite(fd, junk.data(), junk.size(), 4096);
+        ::close(fd);
+
+        ::_exit(0);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+
+    Map cont(name, 8, true, write_ahead{1});
+    ASSERT_EQ(cont.size(), 199u);
+    ASSERT_EQ(cont.find(0), cont.end());
+    for (std::size_t i = 1; i != 200; ++i)
+    {
+        ASSERT_NE(cont.find(i), cont.end()) << "key " << i;
+        ASSERT_EQ(cont.find(i)->second, i);
+    }
+}
+
+TEST_F(WriteAheadLogTest, Subscript)
+{
+    const pid_t pid = ::fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        Map cont(name, 8, false, write_ahead{1});
+        for (std::size_t i = 0; i != 1000; ++i)
+        {
+            cont[i] = i + 1;
+        }
+        for (std::size_t i = 0; i < 1000; i += 2)
+        {
+            cont[i] = i + 2;
+        }
+
+        // the last value is only logged by commit
+        cont[1000] = 1001;
+        cont.commit();
+
+        ::_exit(0);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+
+    Map cont(name, 8, true, write_ahead{1});
+    ASSERT_EQ(cont.size(), 1001u);
+    for (std::size_t i = 0; i != 1001; ++i)
+    {
+        const auto iter = cont.find(i);
+        ASSERT_NE(iter, cont.end()) << "key " << i;
+        ASSERT_EQ(iter->second, i % 2 == 0 && i != 1000 ? i + 2 : i + 1);
+    }
+}
+
+TEST_F(WriteAheadLogTest, DirtyHeader)
+{
+    {
+        Map cont(name, 8, false, write_ahead{1});
+        for (std::size_t i = 0; i != 100; ++i)
+        {
+            cont.emplace(i, i);
+        }
+    }
+
+    const pid_t pid = ::fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        // the header left clean by the close is synced dirty
+        // before any bucket changes
+        Map cont(name, 8, true, write_ahead{1});
+        const auto reopened = cont.flushed().flushes;
+        for (std::size_t i = 100; i != 200; ++i)
+        {
+            cont.emplace(i, i);
+        }
+
+        const auto before = cont.flushed().flushes;
+        cont.checkpoint();
+        const auto after = cont.flushed().flushes;
+        for (std::size_t i = 0; i < 200; i += 2)
+        {
+            cont.erase(i);
+        }
+
+        ::_exit(reopened > 0 && after > before + 1 ? 0 : 1);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    Map cont(name, 8, true, write_ahead{1});
+    ASSERT_EQ(cont.size(), 100u);
+    for (std::size_t i = 0; i != 200; ++i)
+    {
+        ASSERT_EQ(cont.find(i) == cont.end(), i % 2 == 0) << "key " << i;
+    }
+}
+
+TEST_F(WriteAheadLogTest, NoCheckpoint)
+{
+    const pid_t pid = ::fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0)
+    {
+        Map cont(name, 8, false, write_ahead{1});
+        for (std::size_t i = 0; i != 100; ++i)
+        {
+            cont.emplace(i, i);
+        }
+
+        cont.checkpoint();
+
+        for (std::size_t i = 0; i < 100; i += 2)
+        {
+            cont.insert_or_assign(i, i + 1);
+        }
+
+        ::_exit(0);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+
+    // without the checkpoint the log replays onto an empty table,
+    // not onto the file
+    std::remove((name + ".ckpt").c_str());
+
+    Map cont(name, 8, true, write_ahead{1});
+    ASSERT_EQ(cont.size(), 50u);
+    for (std::size_t i = 0; i != 100; ++i)
+    {
+        const auto iter = cont.find(i);
+        if (i % 2 == 0)
+        {
+            ASSERT_NE(iter, cont.end()) << "key " << i;
+            ASSERT_EQ(iter->second, i + 1);
+        }
+        else
+        {
+            ASSERT_EQ(iter, cont.end()) << "key " << i;
+        }
+    }
+}
@@ -4,6 +4,9 @@
 #include <algorithm>
 #include <initializer_list>
 #include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -81,4 +84,81 @@ permutated_insertions(std::size_t buckets, ContIn lis)
     );
 }
 
+/**
+ * @brief Do random emplace, erase and find on cont and on a
+ *        std::unordered_map, checking both agree after each.
+ *
+ * @tparam Cont map from std::size_t to std::size_t
+ * @param cont container to test
+ * @param range keys are in [0,range)
+ * @param ops number of operations
+ */
+template<typename Cont>
+void
+compare_with_std(Cont& cont, std::size_t range, std::size_t ops)
+{
+    std::unordered_map<std::size_t, std::size_t> expected;
+    std::mt19937_64 gen(range);
+
+    for (std::size_t i = 0; i != ops; ++i)
+    {
+        const std::size_t k = gen() % range;
+        switch (gen() % 3)
+        {
+        case 0:
+            ASSERT_EQ(cont.emplace(k, i).second, expected.emplace(k, i).second);
+            break;
+        case 1:
+            ASSERT_EQ(cont.erase(k), expected.erase(k));
+            break;
+        default:
+        {
+            const auto iter = cont.find(k);
+            const auto exp  = expected.find(k);
+            ASSERT_EQ(iter == cont.end(), exp == expected.end()) << "key " << k;
+            if (exp != expected.end())
+            {
+                ASSERT_EQ(iter->second, exp->second);
+            }
+        }
+        }
+    }
+
+    ASSERT_EQ(cont.size(), expected.size());
+    for (const auto& p : expected)
+    {
+        ASSERT_TRUE(cont.contains(p.first)) << "key " << p.first;
+    }
+}
+
+/**
+ * @brief Value of key i for maps of std::string values. It is
+ *        too long to be kept inline, so a string moved as bytes
+ *        rather than by its move constructor is noticed.
+ */
+inline std::string
+long_value(std::size_t i)
+{
+    return "a value longer than the inline buffer " + std::to_string(i);
+}
+
+/**
+ * @brief Check cont holds exactly keys [0,num), each with its
+ *        @ref long_value.
+ *
+ * @tparam Cont map from std::size_t to std::string
+ */
+template<typename Cont>
+void
+check_long_values(Cont& cont, std::size_t num)
+{
+    ASSERT_EQ(cont.size(), num);
+    for (std::size_t i = 0; i != num; ++i)
+    {
+        const auto iter = cont.find(i);
+        ASSERT_NE(iter, cont.end()) << "key " << i;
+        ASSERT_EQ(iter->second, long_value(i)) << "key " << i;
+    }
+}
+
 #endif